@@ -15,6 +15,8 @@
 
 #include "shader.h"
 #include "basic_camera.h"
+#include "boxBatch.h"
+#include "sceneGraph.h"
 
 #include <iostream>
 
@@ -26,7 +28,7 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void processInput(GLFWwindow* window);
 
 // draw object functions
-void drawCube(Shader shaderProgram, unsigned int VAO, glm::mat4 parentTrans, float posX = 0.0, float posY = 0.0, float posz = 0.0, float rotX = 0.0, float rotY = 0.0, float rotZ = 0.0, float scX = 1.0, float scY = 1.0, float scZ = 1.0);
+void drawCube(const SceneGraph& graph, int node);
 
 // settings
 const unsigned int SCR_WIDTH = 800;
@@ -56,6 +58,25 @@ float lookAtX = 0.0, lookAtY = 0.0, lookAtZ = 0.0;
 glm::vec3 V = glm::vec3(0.0f, 1.0f, 0.0f);
 BasicCamera basic_camera(eyeX, eyeY, eyeZ, lookAtX, lookAtY, lookAtZ, V);
 
+// cubes are recorded by drawCube and drawn with one instanced call per frame
+BoxBatch* boxBatch = nullptr;
+
+// one node per cube; the keys only change their transforms, so world matrices are rebuilt on input only
+SceneGraph sceneGraph;
+struct SetUpCube
+{
+    glm::vec3 offset;   // added to translate_X/Y/Z
+    glm::vec3 scale;    // multiplied with scale_X/Y/Z
+    int node;
+};
+SetUpCube setUpCubes[] = {
+    { glm::vec3(-1.0f, -0.10f, 0.0f), glm::vec3(0.2f, 0.5f, 0.15f), -1 },
+    { glm::vec3(0.7f, -0.10f, 0.2f), glm::vec3(0.2f, 0.45f, 0.15f), -1 },
+    { glm::vec3(0.0f, -0.25f, 0.0f), glm::vec3(5.0f, 0.125f, 2.0f), -1 },
+    { glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(1.0f, 1.0f, 0.02f), -1 },      // monitor
+    { glm::vec3(0.5f, 0.0f, 0.0f), glm::vec3(0.5f, 1.0f, 1.0f), -1 }        // pc
+};
+
 // timing
 float deltaTime = 0.0f;    // time between current frame and last frame
 float lastFrame = 0.0f;
@@ -108,6 +129,10 @@ int main()
 
     Shader constantShader("vertexShader.vs", "fragmentShaderV2.fs");
 
+    Shader instancedShader("vertexShaderInstanced.vs", "fragmentShader.fs");
+    instancedShader.use();
+    instancedShader.setBool("useVertexColor", true);
+
     // set up vertex data (and buffer(s)) and configure vertex attributes
     // ------------------------------------------------------------------
     float cube_vertices[] = {
@@ -182,6 +207,15 @@ int main()
     glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)12);
     glEnableVertexAttribArray(1);
 
+    BoxBatch cubeBatch(VBO, EBO);
+    boxBatch = &cubeBatch;
+
+    // every cube is centered on its position: the 0.5 cube VBO is shifted by -0.25 after scaling
+    for (SetUpCube& cube : setUpCubes)
+    {
+        cube.node = sceneGraph.addNode();
+        sceneGraph.setPivot(cube.node, glm::vec3(-0.25f));
+    }
 
     //glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
@@ -211,6 +245,7 @@ int main()
         // pass projection matrix to shader (note that in this case it could change every frame)
         glm::mat4 projection = glm::perspective(glm::radians(basic_camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
         //glm::mat4 projection = glm::ortho(-2.0f, +2.0f, -1.5f, +1.5f, 0.1f, 100.0f);
+        ourShader.use();
         ourShader.setMat4("projection", projection);
         //constantShader.setMat4("projection", projection);
 
@@ -219,13 +254,27 @@ int main()
         ourShader.setMat4("view", view);
         //constantShader.setMat4("view", view);
 
+        instancedShader.use();
+        instancedShader.setMat4("projection", projection);
+        instancedShader.setMat4("view", view);
+
         // Modelling Transformation
-        glm::mat4 identityMatrix = glm::mat4(1.0f); // make sure to initialize matrix to identity matrix first
-        drawCube(ourShader, VAO, identityMatrix, translate_X - 1.0f, translate_Y-.10, translate_Z, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, scale_X * .2, scale_Y*.5, scale_Z*.15);
-        drawCube(ourShader, VAO, identityMatrix, translate_X + 0.7f, translate_Y - .10, translate_Z+0.2, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, scale_X * .2, scale_Y * .45, scale_Z * .15);
-        drawCube(ourShader, VAO, identityMatrix, translate_X, translate_Y-.25, translate_Z, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, scale_X*5.0, scale_Y*0.125, scale_Z*2.0);
-        drawCube(ourShader, VAO, identityMatrix, translate_X, translate_Y, translate_Z, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, scale_X, scale_Y, scale_Z*0.02); // monitor
-        drawCube(ourShader, VAO, identityMatrix, translate_X+0.5f, translate_Y, translate_Z, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, scale_X*.5, scale_Y, scale_Z); // pc
+        // the setters leave a node clean unless the keys changed its transform
+        glm::vec3 translation(translate_X, translate_Y, translate_Z);
+        glm::vec3 rotation(rotateAngle_X, rotateAngle_Y, rotateAngle_Z);
+        glm::vec3 scale(scale_X, scale_Y, scale_Z);
+        for (SetUpCube& cube : setUpCubes)
+        {
+            sceneGraph.setTranslation(cube.node, translation + cube.offset);
+            sceneGraph.setRotation(cube.node, rotation);
+            sceneGraph.setScale(cube.node, scale * cube.scale);
+        }
+        sceneGraph.update();
+        for (const SetUpCube& cube : setUpCubes)
+            drawCube(sceneGraph, cube.node);
+
+        // the whole set up in one instanced draw
+        cubeBatch.draw(instancedShader);
 
         // render boxes
         //for (unsigned int i = 0; i < 10; i++)
@@ -249,6 +298,7 @@ int main()
     glDeleteVertexArrays(1, &VAO);
     glDeleteBuffers(1, &VBO);
     glDeleteBuffers(1, &EBO);
+    boxBatch = nullptr;
 
     // glfw: terminate, clearing all previously allocated GLFW resources.
     // ------------------------------------------------------------------
@@ -382,20 +432,8 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
     basic_camera.ProcessMouseScroll(static_cast<float>(yoffset));
 }
 
-void drawCube(Shader shaderProgram, unsigned int VAO, glm::mat4 parentTrans, float posX, float posY, float posZ, float rotX, float rotY, float rotZ, float scX, float scY, float scZ)
+void drawCube(const SceneGraph& graph, int node)
 {
-    shaderProgram.use();
-
-    glm::mat4 translateMatrix, rotateXMatrix, rotateYMatrix, rotateZMatrix, scaleMatrix, model, modelCentered;
-    translateMatrix = glm::translate(parentTrans, glm::vec3(posX, posY, posZ));
-    rotateXMatrix = glm::rotate(translateMatrix, glm::radians(rotX), glm::vec3(1.0f, 0.0f, 0.0f));
-    rotateYMatrix = glm::rotate(rotateXMatrix, glm::radians(rotY), glm::vec3(0.0f, 1.0f, 0.0f));
-    rotateZMatrix = glm::rotate(rotateYMatrix, glm::radians(rotZ), glm::vec3(0.0f, 0.0f, 1.0f));
-    model = glm::scale(rotateZMatrix, glm::vec3(scX, scY, scZ));
-    modelCentered = glm::translate(model, glm::vec3(-0.25, -0.25, -0.25));
-
-    shaderProgram.setMat4("model", modelCentered);
-
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+    // colors come from the cube vertices, the material slots are unused
+    boxBatch->add(graph.getWorld(node), glm::vec3(1.0f), glm::vec3(1.0f), glm::vec3(0.0f), 32.0f);
 }
@@ -16,7 +16,12 @@
 #include "shader.h"
 #include "basic_camera.h"
 #include "camera.h"
+#include "boxBatch.h"
+#include "frustum.h"
+#include "bvh.h"
+#include "sceneGraph.h"
 #include <iostream>
+#include <vector>
 
 using namespace std;
 
@@ -32,11 +37,13 @@ const double keyPressDelay = 0.2; // delay in seconds
 // draw object functions
 void drawCube(Shader shaderProgram, unsigned int VAO, glm::mat4 parentTrans, float posX = 0.0, float posY = 0.0, float posz = 0.0, float rotX = 0.0, float rotY = 0.0, float rotZ = 0.0, float scX = 1.0, float scY = 1.0, float scZ = 1.0);
 void draw_Table(Shader shaderProgram, unsigned int VAO, glm::mat4 parentTrans, glm::mat4 all_mat);
-void draw_Chair(Shader shaderProgram, unsigned int VAO, glm::mat4 parentTrans, glm::mat4 all_mat);
+void add_Chair(SceneGraph& graph, const glm::vec3& position);
+void draw_Chairs(const SceneGraph& graph);
 void draw_Room(Shader shaderProgram, unsigned int VAO, glm::mat4 parentTrans);
 void draw_Fan(Shader shaderProgram, unsigned int VAO, glm::mat4 parentTrans, glm::mat4 rot);
 void draw_Door(Shader shaderProgram, unsigned int VAO, glm::mat4 parentTrans, glm::mat4 rotation);
 void draw_TV(Shader shaderProgram, unsigned int VAO, glm::mat4 parentTrans);
+void drawBox(Shader& shaderProgram, unsigned int VAO, const glm::mat4& model);
 //void stagebinet(Shader shaderProgram, unsigned int VAO, glm::mat4 parentTrans);
 // settings
 const unsigned int SCR_WIDTH = 1500;
@@ -97,6 +104,26 @@ glm::vec3 cam = glm::vec3(4.0f, 1.0f, -2.0f);
 // camera
 Camera camera(cam);
 
+// chair parts are recorded by draw_Chairs and drawn with one instanced call per frame
+BoxBatch* boxBatch = nullptr;
+
+// the chairs never move: one root node per chair with a child per part, built once; drawing reads
+// the cached world matrices
+SceneGraph sceneGraph;
+struct ChairPart
+{
+    int node;
+    glm::vec3 color;
+};
+std::vector<ChairPart> chairParts;
+
+// boxes outside the view frustum are skipped
+// the scene BVH answers the test for static boxes and refits the fan blades and door as they move
+
+// frustum statistics, printed once per second while enabled (toggle with P)
+bool showFrameStats = false;
+double lastStatsTime = 0.0;
+
 int main()
 {
     // glfw: initialize and configure
@@ -145,6 +172,8 @@ int main()
 
     Shader constantShader("vertexShader.vs", "fragmentShaderV2.fs");
 
+    Shader instancedShader("vertexShaderInstanced.vs", "fragmentShader.fs");
+
     // set up vertex data (and buffer(s)) and configure vertex attributes
     // ------------------------------------------------------------------
     float cube_vertices[] = {
@@ -243,6 +272,13 @@ int main()
     glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)12);
     glEnableVertexAttribArray(1);
 
+    BoxBatch partBatch(VBO, EBO);
+    boxBatch = &partBatch;
+
+    // a row of chairs one unit apart along z
+    for (int j = 0; j < 5; j++)
+        add_Chair(sceneGraph, glm::vec3(0.0f, 0.0f, j + 1.0f));
+
 
     //glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
@@ -272,16 +308,24 @@ int main()
         // pass projection matrix to shader (note that in this case it could change every frame)
         glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
         //glm::mat4 projection = glm::ortho(-2.0f, +2.0f, -1.5f, +1.5f, 0.1f, 100.0f);
+        ourShader.use();
         ourShader.setMat4("projection", projection);
         //constantShader.setMat4("projection", projection);
 
         // camera/view transformation
         glm::mat4 view = camera.GetViewMatrix();
+        Frustum::current().update(projection * view);
+        Frustum::current().resetStats();
+        SceneBvh::current().beginFrame(Frustum::current());
 
         //glm::mat4 view = basic_camera.createViewMatrix();
         ourShader.setMat4("view", view);
         //constantShader.setMat4("view", view);
 
+        instancedShader.use();
+        instancedShader.setMat4("projection", projection);
+        instancedShader.setMat4("view", view);
+
         // Modelling Transformation
         glm::mat4 identityMatrix = glm::mat4(1.0f); // make sure to initialize matrix to identity matrix first
         glm::mat4 translateMatrix, rotateXMatrix, rotateYMatrix, rotateZMatrix, scaleMatrix, model, modelCentered, rotation, translateFan, translateFanBack;
@@ -377,19 +421,18 @@ int main()
             t += 2.0;
             translateMatrix = glm::translate(identityMatrix, glm::vec3(-t, 0.0f, 0.0f));
         }
-        translateMatrix = identityMatrix;
-        t = 0.0;
-        for (int i = 0; i < 1; i++)
-        {
-            for (int j = 0; j < 5; j++) {
-                translateMatrix = translateMatrix * glm::translate(identityMatrix, glm::vec3(0.0f, 0.0f, 1.0f));
+        sceneGraph.update();
+        draw_Chairs(sceneGraph);
 
-                draw_Chair(ourShader, VAO, identityMatrix, translateMatrix);
-            }
-            t += 2.0;
-            translateMatrix = glm::translate(identityMatrix, glm::vec3(-t, 0.0f, 0.0f));
-        }
+        // all chair parts in one instanced draw
+        partBatch.draw(instancedShader);
+        SceneBvh::current().endFrame();
 
+        if (showFrameStats && currentFrame - lastStatsTime >= 1.0)
+        {
+            cout << "frustum: " << Frustum::current().getVisible() << " visible, " << Frustum::current().getCulled() << " culled" << endl;
+            lastStatsTime = currentFrame;
+        }
 
         // render boxes
 
@@ -404,6 +447,7 @@ int main()
     glDeleteVertexArrays(1, &VAO);
     glDeleteBuffers(1, &VBO);
     glDeleteBuffers(1, &EBO);
+    boxBatch = nullptr;
 
     // glfw: terminate, clearing all previously allocated GLFW resources.
     // ------------------------------------------------------------------
@@ -499,6 +543,10 @@ void processInput(GLFWwindow* window)
         }
         lastKeyPressTime = currentTime;
     }
+    if (glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS) {
+        showFrameStats = !showFrameStats;
+        lastKeyPressTime = currentTime;
+    }
     if (glfwGetKey(window, GLFW_KEY_1) == GLFW_PRESS){
         if (doorOpen) {
             doorOpen = false;
@@ -556,10 +604,7 @@ void draw_Room(Shader shaderProgram, unsigned int VAO, glm::mat4 parentTrans) {
     model = scaleMatrix;
     //modelCentered = glm::translate(model, glm::vec3(-0.25, -0.25, -0.25));
 
-    shaderProgram.setMat4("model", model);
-
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+    drawBox(shaderProgram, VAO, model);
     //back wall 1
     shaderProgram.setVec4("color", glm::vec4(0.55f, 0.906f, 0.55f, 1.0f)); //color
     translateMatrix = glm::translate(parentTrans, glm::vec3(-1.5f, -1.0f, 7.0f));
@@ -567,10 +612,7 @@ void draw_Room(Shader shaderProgram, unsigned int VAO, glm::mat4 parentTrans) {
     model = scaleMatrix;
     //modelCentered = glm::translate(model, glm::vec3(-0.25, -0.25, -0.25));
 
-    shaderProgram.setMat4("model", model);
-
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+    drawBox(shaderProgram, VAO, model);
     //back wall 3
     shaderProgram.setVec4("color", glm::vec4(0.55f, 0.906f, 0.55f, 1.0f)); //color
     translateMatrix = glm::translate(parentTrans, glm::vec3(-1.5f, 1.0f, 5.5f));
@@ -578,10 +620,7 @@ void draw_Room(Shader shaderProgram, unsigned int VAO, glm::mat4 parentTrans) {
     model = scaleMatrix;
     //modelCentered = glm::translate(model, glm::vec3(-0.25, -0.25, -0.25));
 
-    shaderProgram.setMat4("model", model);
-
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+    drawBox(shaderProgram, VAO, model);
     //back wall 2
     shaderProgram.setVec4("color", glm::vec4(0.55f, 0.906f, 0.55f, 1.0f)); //color
     translateMatrix = glm::translate(parentTrans, glm::vec3(-1.5f, -1.0f, -4.0f));
@@ -589,10 +628,7 @@ void draw_Room(Shader shaderProgram, unsigned int VAO, glm::mat4 parentTrans) {
     model = scaleMatrix;
     //modelCentered = glm::translate(model, glm::vec3(-0.25, -0.25, -0.25));
 
-    shaderProgram.setMat4("model", model);
-
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+    drawBox(shaderProgram, VAO, model);
 
     //right side wall 1
     shaderProgram.setVec4("color", glm::vec4(0.0f, 0.769f, 0.627f, 1.0f)); //color
@@ -601,10 +637,7 @@ void draw_Room(Shader shaderProgram, unsigned int VAO, glm::mat4 parentTrans) {
     model = scaleMatrix;
     //modelCentered = glm::translate(model, glm::vec3(-0.25, -0.25, -0.25));
 
-    shaderProgram.setMat4("model", model);
-
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+    drawBox(shaderProgram, VAO, model);
     //left side wall 1
     shaderProgram.setVec4("color", glm::vec4(0.961f, 0.769f, 0.627f, 1.0f)); //color
     translateMatrix = glm::translate(parentTrans, glm::vec3(-1.5f, -1.0f, 9.0f));
@@ -612,10 +645,7 @@ void draw_Room(Shader shaderProgram, unsigned int VAO, glm::mat4 parentTrans) {
     model = scaleMatrix;
     //modelCentered = glm::translate(model, glm::vec3(-0.25, -0.25, -0.25));
 
-    shaderProgram.setMat4("model", model);
-
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+    drawBox(shaderProgram, VAO, model);
     //front side wall 1
     shaderProgram.setVec4("color", glm::vec4(1.0f, 0.906f, 0.635f, 1.0f)); //color
     translateMatrix = glm::translate(parentTrans, glm::vec3(5.5f, -1.0f, -4.0f));
@@ -623,10 +653,7 @@ void draw_Room(Shader shaderProgram, unsigned int VAO, glm::mat4 parentTrans) {
     model = scaleMatrix;
     //modelCentered = glm::translate(model, glm::vec3(-0.25, -0.25, -0.25));
 
-    shaderProgram.setMat4("model", model);
-
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+    drawBox(shaderProgram, VAO, model);
 
     //ceiling
     shaderProgram.setVec4("color", glm::vec4(0.9f, 0.849f, 0.929f, 1.0f)); //color
@@ -635,10 +662,7 @@ void draw_Room(Shader shaderProgram, unsigned int VAO, glm::mat4 parentTrans) {
     model = scaleMatrix;
     //modelCentered = glm::translate(model, glm::vec3(-0.25, -0.25, -0.25));
 
-    shaderProgram.setMat4("model", model);
-
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+    drawBox(shaderProgram, VAO, model);
 }
 void draw_TV(Shader shaderProgram, unsigned int VAO, glm::mat4 parentTrans) {
     shaderProgram.use();
@@ -654,9 +678,7 @@ void draw_TV(Shader shaderProgram, unsigned int VAO, glm::mat4 parentTrans) {
     scaleMatrix = glm::scale(translateMatrix, glm::vec3(3.0f, 3.0f, 0.1f));
     model = scaleMatrix;
     //modelCentered = glm::translate(model, glm::vec3(-0.25, -0.25, -0.25));
-    shaderProgram.setMat4("model", model);
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+    drawBox(shaderProgram, VAO, model);
 
     // right
     shaderProgram.setVec4("color", glm::vec4(0.051f, 0.329f, 0.349f, 1.0f)); //color
@@ -664,9 +686,7 @@ void draw_TV(Shader shaderProgram, unsigned int VAO, glm::mat4 parentTrans) {
     scaleMatrix = glm::scale(translateMatrix, glm::vec3(0.2f, 3.0f, 0.1f));
     model = scaleMatrix;
     //modelCentered = glm::translate(model, glm::vec3(-0.25, -0.25, -0.25));
-    shaderProgram.setMat4("model", model);
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+    drawBox(shaderProgram, VAO, model);
 
     // left
     shaderProgram.setVec4("color", glm::vec4(0.051f, 0.329f, 0.349f, 1.0f)); //color
@@ -674,9 +694,7 @@ void draw_TV(Shader shaderProgram, unsigned int VAO, glm::mat4 parentTrans) {
     scaleMatrix = glm::scale(translateMatrix, glm::vec3(0.2f, 3.0f, 0.1f));
     model = scaleMatrix;
     //modelCentered = glm::translate(model, glm::vec3(-0.25, -0.25, -0.25));
-    shaderProgram.setMat4("model", model);
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+    drawBox(shaderProgram, VAO, model);
 
     // up
     shaderProgram.setVec4("color", glm::vec4(0.051f, 0.329f, 0.349f, 1.0f)); //color
@@ -684,9 +702,7 @@ void draw_TV(Shader shaderProgram, unsigned int VAO, glm::mat4 parentTrans) {
     scaleMatrix = glm::scale(translateMatrix, glm::vec3(3.0f, 0.2f, 0.1f));
     model = scaleMatrix;
     //modelCentered = glm::translate(model, glm::vec3(-0.25, -0.25, -0.25));
-    shaderProgram.setMat4("model", model);
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+    drawBox(shaderProgram, VAO, model);
 
     // down
     shaderProgram.setVec4("color", glm::vec4(0.051f, 0.329f, 0.349f, 1.0f)); //color
@@ -694,9 +710,7 @@ void draw_TV(Shader shaderProgram, unsigned int VAO, glm::mat4 parentTrans) {
     scaleMatrix = glm::scale(translateMatrix, glm::vec3(3.0f, 0.2f, 0.1f));
     model = scaleMatrix;
     //modelCentered = glm::translate(model, glm::vec3(-0.25, -0.25, -0.25));
-    shaderProgram.setMat4("model", model);
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+    drawBox(shaderProgram, VAO, model);
 
 
     //TV background
@@ -705,9 +719,7 @@ void draw_TV(Shader shaderProgram, unsigned int VAO, glm::mat4 parentTrans) {
     scaleMatrix = glm::scale(translateMatrix, glm::vec3(3.0f, 3.0f, 0.1f));
     model = scaleMatrix;
     //modelCentered = glm::translate(model, glm::vec3(-0.25, -0.25, -0.25));
-    shaderProgram.setMat4("model", model);
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+    drawBox(shaderProgram, VAO, model);
 
     // right
     shaderProgram.setVec4("color", glm::vec4(0.051f, 0.329f, 0.349f, 1.0f)); //color
@@ -715,9 +727,7 @@ void draw_TV(Shader shaderProgram, unsigned int VAO, glm::mat4 parentTrans) {
     scaleMatrix = glm::scale(translateMatrix, glm::vec3(0.2f, 3.0f, 0.1f));
     model = scaleMatrix;
     //modelCentered = glm::translate(model, glm::vec3(-0.25, -0.25, -0.25));
-    shaderProgram.setMat4("model", model);
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+    drawBox(shaderProgram, VAO, model);
 
     // left
     shaderProgram.setVec4("color", glm::vec4(0.051f, 0.329f, 0.349f, 1.0f)); //color
@@ -725,9 +735,7 @@ void draw_TV(Shader shaderProgram, unsigned int VAO, glm::mat4 parentTrans) {
     scaleMatrix = glm::scale(translateMatrix, glm::vec3(0.2f, 3.0f, 0.1f));
     model = scaleMatrix;
     //modelCentered = glm::translate(model, glm::vec3(-0.25, -0.25, -0.25));
-    shaderProgram.setMat4("model", model);
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+    drawBox(shaderProgram, VAO, model);
 
     // up
     shaderProgram.setVec4("color", glm::vec4(0.051f, 0.329f, 0.349f, 1.0f)); //color
@@ -735,9 +743,7 @@ void draw_TV(Shader shaderProgram, unsigned int VAO, glm::mat4 parentTrans) {
     scaleMatrix = glm::scale(translateMatrix, glm::vec3(3.0f, 0.2f, 0.1f));
     model = scaleMatrix;
     //modelCentered = glm::translate(model, glm::vec3(-0.25, -0.25, -0.25));
-    shaderProgram.setMat4("model", model);
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+    drawBox(shaderProgram, VAO, model);
 
     // down
     shaderProgram.setVec4("color", glm::vec4(0.051f, 0.329f, 0.349f, 1.0f)); //color
@@ -745,9 +751,7 @@ void draw_TV(Shader shaderProgram, unsigned int VAO, glm::mat4 parentTrans) {
     scaleMatrix = glm::scale(translateMatrix, glm::vec3(3.0f, 0.2f, 0.1f));
     model = scaleMatrix;
     //modelCentered = glm::translate(model, glm::vec3(-0.25, -0.25, -0.25));
-    shaderProgram.setMat4("model", model);
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+    drawBox(shaderProgram, VAO, model);
 
 }
 void draw_Fan(Shader shaderProgram, unsigned int VAO, glm::mat4 parentTrans, glm::mat4 rot) {
@@ -762,10 +766,7 @@ void draw_Fan(Shader shaderProgram, unsigned int VAO, glm::mat4 parentTrans, glm
     model = translate(parentTrans, glm::vec3(-1.3f, 2.0f, 0.55f)) * rot * scaleMatrix;
     //modelCentered = glm::translate(model, glm::vec3(-0.25, -0.25, -0.25));
 
-    shaderProgram.setMat4("model", model);
-
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+    drawBox(shaderProgram, VAO, model);
     //fan base rod
     shaderProgram.setVec4("color", glm::vec4(0.561f, 0.561f, 0.561f, 1.0f)); //color
 
@@ -774,10 +775,7 @@ void draw_Fan(Shader shaderProgram, unsigned int VAO, glm::mat4 parentTrans, glm
     model = translate(parentTrans, glm::vec3(-1.3f, 2.0f, 0.55f)) * scaleMatrix;
     //modelCentered = glm::translate(model, glm::vec3(-0.25, -0.25, -0.25));
 
-    shaderProgram.setMat4("model", model);
-
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+    drawBox(shaderProgram, VAO, model);
     //fan blade 1
     shaderProgram.setVec4("color", glm::vec4(0.69f, 0.69f, 0.69f, 1.0f)); //color
 
@@ -786,10 +784,7 @@ void draw_Fan(Shader shaderProgram, unsigned int VAO, glm::mat4 parentTrans, glm
     model = translate(parentTrans, glm::vec3(-1.3f, 2.0f, 0.55f)) * rot * scaleMatrix;
     //modelCentered = glm::translate(model, glm::vec3(-0.25, -0.25, -0.25));
 
-    shaderProgram.setMat4("model", model);
-
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+    drawBox(shaderProgram, VAO, model);
     //fan blade 2
     shaderProgram.setVec4("color", glm::vec4(0.69f, 0.69f, 0.69f, 1.0f)); //color
 
@@ -799,10 +794,7 @@ void draw_Fan(Shader shaderProgram, unsigned int VAO, glm::mat4 parentTrans, glm
     model = translate(parentTrans, glm::vec3(-1.3f, 2.0f, 0.55f)) * rot * scaleMatrix;
     //modelCentered = glm::translate(model, glm::vec3(-0.25, -0.25, -0.25));
 
-    shaderProgram.setMat4("model", model);
-
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+    drawBox(shaderProgram, VAO, model);
     //fan blade 3
     shaderProgram.setVec4("color", glm::vec4(0.69f, 0.69f, 0.69f, 1.0f)); //color
 
@@ -812,10 +804,7 @@ void draw_Fan(Shader shaderProgram, unsigned int VAO, glm::mat4 parentTrans, glm
     model = translate(parentTrans, glm::vec3(-1.3f, 2.0f, 0.55f)) * rot * scaleMatrix;
     //modelCentered = glm::translate(model, glm::vec3(-0.25, -0.25, -0.25));
 
-    shaderProgram.setMat4("model", model);
-
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+    drawBox(shaderProgram, VAO, model);
     //fan blade 4
     shaderProgram.setVec4("color", glm::vec4(0.69f, 0.69f, 0.69f, 1.0f)); //color
 
@@ -825,10 +814,7 @@ void draw_Fan(Shader shaderProgram, unsigned int VAO, glm::mat4 parentTrans, glm
     model = translate(parentTrans, glm::vec3(-1.3f, 2.0f, 0.55f)) * rot * scaleMatrix;
     //modelCentered = glm::translate(model, glm::vec3(-0.25, -0.25, -0.25));
 
-    shaderProgram.setMat4("model", model);
-
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+    drawBox(shaderProgram, VAO, model);
 }
 void draw_Door(Shader shaderProgram, unsigned int VAO, glm::mat4 parentTrans, glm::mat4 rotation)
 {
@@ -842,16 +828,7 @@ void draw_Door(Shader shaderProgram, unsigned int VAO, glm::mat4 parentTrans, gl
     model = translate(parentTrans, glm::vec3(-1.5f, -1.0f, 7.0f)) * rotation * scaleMatrix;
     //modelCentered = glm::translate(model, glm::vec3(-0.25, -0.25, -0.25));
 
-    shaderProgram.setMat4("model", model);
-
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+    drawBox(shaderProgram, VAO, model);
 }
 void draw_Table(Shader shaderProgram, unsigned int VAO, glm::mat4 parentTrans, glm::mat4 all_mat)
 {
@@ -864,10 +841,7 @@ void draw_Table(Shader shaderProgram, unsigned int VAO, glm::mat4 parentTrans, g
     model = all_mat * scaleMatrix;
     //modelCentered = glm::translate(model, glm::vec3(-0.25, -0.25, -0.25));
 
-    shaderProgram.setMat4("model", model);
-
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+    drawBox(shaderProgram, VAO, model);
 
     //table leg_1
     shaderProgram.setVec4("color", glm::vec4(0.1f, 0.1f, 0.1f, 1.0f));
@@ -876,10 +850,7 @@ void draw_Table(Shader shaderProgram, unsigned int VAO, glm::mat4 parentTrans, g
     model = all_mat * scaleMatrix;
     //modelCentered = glm::translate(model, glm::vec3(-0.25, -0.25, -0.25));
 
-    shaderProgram.setMat4("model", model);
-
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+    drawBox(shaderProgram, VAO, model);
 
     //table leg_base1
     shaderProgram.setVec4("color", glm::vec4(0.1f, 0.1f, 0.1f, 1.0f));
@@ -888,10 +859,7 @@ void draw_Table(Shader shaderProgram, unsigned int VAO, glm::mat4 parentTrans, g
     model = all_mat * scaleMatrix;
     //modelCentered = glm::translate(model, glm::vec3(-0.25, -0.25, -0.25));
 
-    shaderProgram.setMat4("model", model);
-
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+    drawBox(shaderProgram, VAO, model);
 
     //table leg_2
     translateMatrix = glm::translate(parentTrans, glm::vec3(0.90f, 0.0f, 3.2f));
@@ -899,10 +867,7 @@ void draw_Table(Shader shaderProgram, unsigned int VAO, glm::mat4 parentTrans, g
     model = all_mat * scaleMatrix;
     //modelCentered = glm::translate(model, glm::vec3(-0.25, -0.25, -0.25));
 
-    shaderProgram.setMat4("model", model);
-
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+    drawBox(shaderProgram, VAO, model);
 
     //table leg_base1
     shaderProgram.setVec4("color", glm::vec4(0.1f, 0.1f, 0.1f, 1.0f));
@@ -911,70 +876,78 @@ void draw_Table(Shader shaderProgram, unsigned int VAO, glm::mat4 parentTrans, g
     model = all_mat * scaleMatrix;
     //modelCentered = glm::translate(model, glm::vec3(-0.25, -0.25, -0.25));
 
-    shaderProgram.setMat4("model", model);
-
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+    drawBox(shaderProgram, VAO, model);
 }
-void drawPart(Shader shaderProgram,unsigned int VAO,glm::mat4 parentTrans,glm::mat4 all_mat,glm::vec3 translation,glm::vec3 scale,glm::vec4 color) {
-    shaderProgram.use();
-
-    // Set color
-    shaderProgram.setVec4("color", color);
-
-    // Add translation along the x-axis
-    translation.x += 2.0f;
-
-    // Create transformation matrix
-    glm::mat4 translateMatrix = glm::translate(parentTrans, translation);
-    glm::mat4 scaleMatrix = glm::scale(translateMatrix, scale);
-    glm::mat4 model = all_mat * scaleMatrix;
-
-    // Pass transformation matrix to the shader
-    shaderProgram.setMat4("model", model);
-
-    // Render the part
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-}
-void draw_Chair(Shader shaderProgram, unsigned int VAO, glm::mat4 parentTrans, glm::mat4 all_mat) {
-    glm::vec4 chairColor = glm::vec4(0.9f, 0.9f, 0.8f, 1.0f);
+// one child node per chair part under a root node at position
+void add_Chair(SceneGraph& graph, const glm::vec3& position) {
+    glm::vec3 chairColor = glm::vec3(0.9f, 0.9f, 0.8f);
+    int chair = graph.addNode();
+    graph.setTranslation(chair, position);
+
+    auto addPart = [&](glm::vec3 translation, glm::vec3 scale) {
+        // parts are laid out 2 units along x from the chair's origin
+        translation.x += 2.0f;
+        int part = graph.addNode(chair);
+        graph.setTranslation(part, translation);
+        graph.setScale(part, scale);
+        chairParts.push_back({ part, chairColor });
+    };
 
     // Chair base
-    drawPart(shaderProgram, VAO, parentTrans, all_mat, glm::vec3(1.00f, -0.5f, 0.4f), glm::vec3(1.2f, 0.2f, 1.2f), chairColor);
+    addPart(glm::vec3(1.00f, -0.5f, 0.4f), glm::vec3(1.2f, 0.2f, 1.2f));
 
-    drawPart(shaderProgram, VAO, parentTrans, all_mat, glm::vec3(-1.65f, -0.5f, 0.4f), glm::vec3(1.2f, 0.2f, 1.2f), chairColor);
+    addPart(glm::vec3(-1.65f, -0.5f, 0.4f), glm::vec3(1.2f, 0.2f, 1.2f));
 
 
     // Chair legs
     glm::vec3 legScale = glm::vec3(0.2f, -1.0f, 0.2f);
 
-    drawPart(shaderProgram, VAO, parentTrans, all_mat, glm::vec3(1.00f, -0.5f, 0.4f), legScale, chairColor);
-    drawPart(shaderProgram, VAO, parentTrans, all_mat, glm::vec3(1.50f, -0.5f, 0.4f), legScale, chairColor);
-    drawPart(shaderProgram, VAO, parentTrans, all_mat, glm::vec3(1.00f, -0.5f, 0.9f), legScale, chairColor);
-    drawPart(shaderProgram, VAO, parentTrans, all_mat, glm::vec3(1.50f, -0.5f, 0.9f), legScale, chairColor);
+    addPart(glm::vec3(1.00f, -0.5f, 0.4f), legScale);
+    addPart(glm::vec3(1.50f, -0.5f, 0.4f), legScale);
+    addPart(glm::vec3(1.00f, -0.5f, 0.9f), legScale);
+    addPart(glm::vec3(1.50f, -0.5f, 0.9f), legScale);
 
-    drawPart(shaderProgram, VAO, parentTrans, all_mat, glm::vec3(-1.65f, -0.5f, 0.4f), legScale, chairColor);
-    drawPart(shaderProgram, VAO, parentTrans, all_mat, glm::vec3(-1.15f, -0.5f, 0.4f), legScale, chairColor);
-    drawPart(shaderProgram, VAO, parentTrans, all_mat, glm::vec3(-1.65f, -0.5f, 0.9f), legScale, chairColor);
-    drawPart(shaderProgram, VAO, parentTrans, all_mat, glm::vec3(-1.15f, -0.5f, 0.9f), legScale, chairColor);
+    addPart(glm::vec3(-1.65f, -0.5f, 0.4f), legScale);
+    addPart(glm::vec3(-1.15f, -0.5f, 0.4f), legScale);
+    addPart(glm::vec3(-1.65f, -0.5f, 0.9f), legScale);
+    addPart(glm::vec3(-1.15f, -0.5f, 0.9f), legScale);
 
 
     // Chair upper vertical parts
     glm::vec3 upperVerticalScale = glm::vec3(0.2f, -1.5f, 0.2f);
-    drawPart(shaderProgram, VAO, parentTrans, all_mat, glm::vec3(1.50f, 0.35f, 0.9f), upperVerticalScale, chairColor);
-    drawPart(shaderProgram, VAO, parentTrans, all_mat, glm::vec3(1.50f, 0.35f, 0.4f), upperVerticalScale, chairColor);
-
-    drawPart(shaderProgram, VAO, parentTrans, all_mat, glm::vec3(-1.65f, 0.35f, 0.9f), upperVerticalScale, chairColor);
-    drawPart(shaderProgram, VAO, parentTrans, all_mat, glm::vec3(-1.65f, 0.35f, 0.4f), upperVerticalScale, chairColor);
+    addPart(glm::vec3(1.50f, 0.35f, 0.9f), upperVerticalScale);
+    addPart(glm::vec3(1.50f, 0.35f, 0.4f), upperVerticalScale);
 
+    addPart(glm::vec3(-1.65f, 0.35f, 0.9f), upperVerticalScale);
+    addPart(glm::vec3(-1.65f, 0.35f, 0.4f), upperVerticalScale);
 
 
     // Chair upper horizontal parts
-    drawPart(shaderProgram, VAO, parentTrans, all_mat, glm::vec3(1.50f, 0.3f, 0.4f), glm::vec3(0.2f, 0.2f, 1.2f), chairColor);
-    drawPart(shaderProgram, VAO, parentTrans, all_mat, glm::vec3(1.50f, 0.0f, 0.4f), glm::vec3(0.2f, 1.2f, 1.2f), chairColor);
+    addPart(glm::vec3(1.50f, 0.3f, 0.4f), glm::vec3(0.2f, 0.2f, 1.2f));
+    addPart(glm::vec3(1.50f, 0.0f, 0.4f), glm::vec3(0.2f, 1.2f, 1.2f));
 
-    drawPart(shaderProgram, VAO, parentTrans, all_mat, glm::vec3(-1.65f, 0.3f, 0.4f), glm::vec3(0.2f, 0.2f, 1.2f), chairColor);
-    drawPart(shaderProgram, VAO, parentTrans, all_mat, glm::vec3(-1.65f, 0.0f, 0.4f), glm::vec3(0.2f, 1.2f, 1.2f), chairColor);
+    addPart(glm::vec3(-1.65f, 0.3f, 0.4f), glm::vec3(0.2f, 0.2f, 1.2f));
+    addPart(glm::vec3(-1.65f, 0.0f, 0.4f), glm::vec3(0.2f, 1.2f, 1.2f));
+}
+// records every visible chair part; the batch renders them all at once
+void draw_Chairs(const SceneGraph& graph) {
+    for (const ChairPart& part : chairParts)
+    {
+        const glm::mat4& model = graph.getWorld(part.node);
+        if (!SceneBvh::current().isVisible(model, glm::vec3(0.0f), glm::vec3(0.5f)))
+            continue;
+        boxBatch->add(model, part.color, part.color, glm::vec3(0.0f), 32.0f);
+    }
+}
 
+// one cube of the room; skipped when the scene BVH finds it outside the view frustum
+void drawBox(Shader& shaderProgram, unsigned int VAO, const glm::mat4& model)
+{
+    // the cube VBO spans (0,0,0)-(0.5,0.5,0.5)
+    if (!SceneBvh::current().isVisible(model, glm::vec3(0.0f), glm::vec3(0.5f)))
+        return;
+
+    shaderProgram.setMat4("model", model);
+    glBindVertexArray(VAO);
+    glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
 }
@@ -0,0 +1,19 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aColor;
+
+// per-instance attributes (see boxBatch.h); only the model matrix and diffuse color are used here
+layout (location = 2) in mat3x4 aModel;   // rows of the affine model matrix, locations 2-4
+layout (location = 7) in vec3 aDiffuse;
+
+out vec4 color;
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform bool useVertexColor = false;   // keep the per-face cube colors instead of the instance color
+
+void main()
+{
+    gl_Position = projection * view * vec4(vec4(aPos, 1.0f) * aModel, 1.0f);
+    color = useVertexColor ? vec4(aColor, 1.0f) : vec4(aDiffuse, 1.0f);
+}
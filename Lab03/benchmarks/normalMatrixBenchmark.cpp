@@ -0,0 +1,133 @@
+//
+//  normalMatrixBenchmark.cpp
+//  runs the vertex stage arithmetic of many 50x50 hyperboloids on the CPU, once inverting the
+//  model matrix per vertex as the shaders used to and once with Affine::normalMatrix() computed
+//  per object, and prints the vertex throughput of each; no window or GL context needed
+//
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "../code/affine.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+// the kitchen hyperboloid's shape and tessellation, drawn many times per frame
+const float A = 0.1f, B = 0.2f, C = 0.15f;
+const int SEGMENTS = 50;
+const int OBJECTS = 256;
+const int FRAMES = 20;
+
+// a shader invocation starts from nothing for every vertex; reading the model through this index
+// keeps the compiler from hoisting the per-vertex inverse out of the loop
+volatile int uniformSlot = 0;
+
+static float randomFloat(float low, float high)
+{
+    return low + (high - low) * (float)rand() / (float)RAND_MAX;
+}
+
+// positions and normals as Hyperboloid::generateVertices lays them out
+void generateHyperboloid(vector<glm::vec3>& positions, vector<glm::vec3>& normals)
+{
+    for (int i = 0; i <= SEGMENTS; ++i)
+    {
+        float v = -2.0f + i * (4.0f / SEGMENTS);
+        for (int j = 0; j <= SEGMENTS; ++j)
+        {
+            float u = j * (2.0f * 3.1416f / SEGMENTS);
+            float x = A * cosh(v) * cos(u);
+            float z = B * cosh(v) * sin(u);
+            float y = C * sinh(v);
+            positions.push_back(glm::vec3(x, y, z));
+            normals.push_back(glm::vec3(x / (A * A), y / (B * B), -z / (C * C)));
+        }
+    }
+}
+
+// the old shaders: inverse(mat3(model rows)) for every vertex
+void shadeInverse(const Affine* models, const vector<glm::vec3>& positions, const vector<glm::vec3>& normals,
+    vector<glm::vec3>& worldPositions, vector<glm::vec3>& worldNormals)
+{
+    for (size_t i = 0; i < positions.size(); i++)
+    {
+        const Affine& model = models[uniformSlot];
+        worldPositions[i] = model.transformPoint(positions[i]);
+        glm::mat3 transposed(glm::vec3(model.rows[0]), glm::vec3(model.rows[1]), glm::vec3(model.rows[2]));
+        worldNormals[i] = glm::normalize(glm::inverse(transposed) * normals[i]);
+    }
+}
+
+// the new shaders: one mat3 multiply by the precomputed normal matrix
+void shadePrecomputed(const Affine* models, const glm::mat3* normalMatrices, const vector<glm::vec3>& positions,
+    const vector<glm::vec3>& normals, vector<glm::vec3>& worldPositions, vector<glm::vec3>& worldNormals)
+{
+    for (size_t i = 0; i < positions.size(); i++)
+    {
+        int slot = uniformSlot;
+        worldPositions[i] = models[slot].transformPoint(positions[i]);
+        worldNormals[i] = glm::normalize(normalMatrices[slot] * normals[i]);
+    }
+}
+
+int main()
+{
+    srand(4208);
+    vector<glm::vec3> positions, normals;
+    generateHyperboloid(positions, normals);
+
+    // half rotated and uniformly scaled (the fast path), half stretched per axis
+    vector<Affine> models;
+    for (int object = 0; object < OBJECTS; object++)
+    {
+        glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(randomFloat(-5.0f, 5.0f), 0.0f, randomFloat(-5.0f, 5.0f)));
+        model = glm::rotate(model, glm::radians(randomFloat(0.0f, 360.0f)), glm::normalize(glm::vec3(randomFloat(-1.0f, 1.0f), 1.0f, randomFloat(-1.0f, 1.0f))));
+        float s = randomFloat(0.5f, 2.0f);
+        model = glm::scale(model, object % 2 == 0 ? glm::vec3(s) : glm::vec3(s, randomFloat(0.5f, 2.0f), randomFloat(0.5f, 2.0f)));
+        models.push_back(Affine(model));
+    }
+
+    vector<glm::vec3> worldPositions(positions.size()), worldNormals(positions.size());
+    vector<glm::vec3> expectedNormals(positions.size());
+    vector<glm::mat3> normalMatrices(OBJECTS);
+
+    auto start = chrono::high_resolution_clock::now();
+    for (int frame = 0; frame < FRAMES; frame++)
+        for (int object = 0; object < OBJECTS; object++)
+            shadeInverse(&models[object], positions, normals, worldPositions, worldNormals);
+    double inverseTime = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count() / FRAMES;
+
+    // the per-object work the draw calls now do on the CPU is included in the timing
+    start = chrono::high_resolution_clock::now();
+    for (int frame = 0; frame < FRAMES; frame++)
+        for (int object = 0; object < OBJECTS; object++)
+        {
+            normalMatrices[object] = models[object].normalMatrix();
+            shadePrecomputed(&models[object], &normalMatrices[object], positions, normals, worldPositions, worldNormals);
+        }
+    double precomputedTime = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count() / FRAMES;
+
+    // both paths must light every vertex of every object the same way
+    float maxError = 0.0f;
+    for (int object = 0; object < OBJECTS; object++)
+    {
+        shadeInverse(&models[object], positions, normals, worldPositions, expectedNormals);
+        shadePrecomputed(&models[object], &normalMatrices[object], positions, normals, worldPositions, worldNormals);
+        for (size_t i = 0; i < positions.size(); i++)
+            maxError = glm::max(maxError, glm::length(worldNormals[i] - expectedNormals[i]));
+    }
+
+    double vertices = (double)positions.size() * OBJECTS;
+    cout << OBJECTS << " hyperboloids of " << positions.size() << " vertices" << endl;
+    cout << "inverse per vertex:    " << inverseTime << " ms per frame, " << vertices / inverseTime / 1000.0 << " M vertices/s" << endl;
+    cout << "normal matrix uniform: " << precomputedTime << " ms per frame, " << vertices / precomputedTime / 1000.0
+         << " M vertices/s (" << inverseTime / precomputedTime << "x)" << endl;
+    cout << "largest normal difference: " << maxError << endl;
+    return 0;
+}
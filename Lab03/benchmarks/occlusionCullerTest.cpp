@@ -0,0 +1,60 @@
+//
+//  occlusionCullerTest.cpp
+//  puts one wall into OcclusionCuller and checks which boxes around it come out hidden; prints each
+//  case and returns nonzero if any is wrong; no window or GL context needed
+//
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "../code/occlusionCuller.h"
+
+#include <iostream>
+
+using namespace std;
+
+// the wall faces the camera, which sits at the origin and looks down -z through the window's 4:3 buffer
+const glm::vec3 WALL_MIN(-2.0f, -1.5f, -5.2f);
+const glm::vec3 WALL_MAX(2.0f, 1.5f, -5.0f);
+const glm::mat4 IDENTITY(1.0f);
+
+static int failures = 0;
+
+static void check(const char* name, bool visible, bool expected)
+{
+    cout << (visible == expected ? "ok   " : "FAIL ") << name << ": " << (visible ? "visible" : "hidden") << endl;
+    if (visible != expected)
+        failures++;
+}
+
+// a fresh buffer holding only the wall, its right edge moved by shift
+static void drawWall(OcclusionCuller& culler, float shift)
+{
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 4.0f / 3.0f, 0.1f, 100.0f);
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    culler.begin(projection * view);
+    culler.addOccluder(IDENTITY, WALL_MIN, WALL_MAX + glm::vec3(shift, 0.0f, 0.0f));
+}
+
+int main()
+{
+    OcclusionCuller culler;
+    drawWall(culler, 0.0f);
+    check("box behind the wall", culler.isVisible(IDENTITY, glm::vec3(-0.5f, -0.5f, -9.0f), glm::vec3(0.5f, 0.5f, -8.0f)), false);
+    check("box in front of the wall", culler.isVisible(IDENTITY, glm::vec3(-0.5f, -0.5f, -3.0f), glm::vec3(0.5f, 0.5f, -2.0f)), true);
+    check("the wall itself", culler.isVisible(IDENTITY, WALL_MIN, WALL_MAX), true);
+
+    // a third of a pixel of the box shows past the wall's right edge, which lands at x * 8 / 5 at the box's
+    // depth; sliding the edge across two pixels puts it on both sides of a pixel center
+    bool straddlingVisible = true;
+    for (int step = 0; step < 8; step++)
+    {
+        float shift = 0.01f * step;
+        drawWall(culler, shift);
+        float edge = (WALL_MAX.x + shift) * 8.0f / 5.0f;
+        if (!culler.isVisible(IDENTITY, glm::vec3(edge - 0.2f, -0.5f, -9.0f), glm::vec3(edge + 0.02f, 0.5f, -8.0f)))
+            straddlingVisible = false;
+    }
+    check("box straddling the wall's edge", straddlingVisible, true);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,109 @@
+//
+//  transformBenchmark.cpp
+//  composes the world matrices of a few thousand nodes with per-object glm calls and with
+//  TransformStore, and prints the time per frame of each; no window or GL context needed
+//
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "../code/transformStore.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+// nodes per frame: rooms of 18 part chairs, like the meeting room but many more of them
+const int CHAIRS = 512;
+const int PARTS_PER_CHAIR = 18;
+const int FRAMES = 200;
+
+struct Node
+{
+    int parent;
+    glm::vec3 position;
+    glm::vec3 rotation;     // degrees
+    glm::vec3 scale;
+};
+
+static float randomFloat(float low, float high)
+{
+    return low + (high - low) * (float)rand() / (float)RAND_MAX;
+}
+
+// what the draw functions do today: one glm temporary per step, per object, every frame
+void composeGlm(const vector<Node>& nodes, vector<glm::mat4>& world)
+{
+    glm::mat4 identityMatrix = glm::mat4(1.0f);
+    for (size_t i = 0; i < nodes.size(); i++)
+    {
+        const Node& node = nodes[i];
+        glm::mat4 translateMatrix = glm::translate(identityMatrix, node.position);
+        glm::mat4 rotateXMatrix = glm::rotate(identityMatrix, glm::radians(node.rotation.x), glm::vec3(1.0f, 0.0f, 0.0f));
+        glm::mat4 rotateYMatrix = glm::rotate(identityMatrix, glm::radians(node.rotation.y), glm::vec3(0.0f, 1.0f, 0.0f));
+        glm::mat4 rotateZMatrix = glm::rotate(identityMatrix, glm::radians(node.rotation.z), glm::vec3(0.0f, 0.0f, 1.0f));
+        glm::mat4 scaleMatrix = glm::scale(identityMatrix, node.scale);
+        glm::mat4 model = translateMatrix * rotateXMatrix * rotateYMatrix * rotateZMatrix * scaleMatrix;
+        world[i] = node.parent >= 0 ? world[node.parent] * model : model;
+    }
+}
+
+int main()
+{
+    srand(4208);
+    vector<Node> nodes;
+    for (int chair = 0; chair < CHAIRS; chair++)
+    {
+        int root = (int)nodes.size();
+        nodes.push_back({ -1, glm::vec3(randomFloat(-50.0f, 50.0f), 0.0f, randomFloat(-50.0f, 50.0f)),
+            glm::vec3(0.0f, randomFloat(0.0f, 360.0f), 0.0f), glm::vec3(1.0f) });
+        for (int part = 0; part < PARTS_PER_CHAIR; part++)
+            nodes.push_back({ root, glm::vec3(randomFloat(-2.0f, 2.0f), randomFloat(-1.0f, 1.0f), randomFloat(0.0f, 1.0f)),
+                glm::vec3(randomFloat(-30.0f, 30.0f), randomFloat(-30.0f, 30.0f), randomFloat(-30.0f, 30.0f)),
+                glm::vec3(randomFloat(0.2f, 1.2f), randomFloat(-1.5f, 1.2f), randomFloat(0.2f, 1.2f)) });
+    }
+
+    TransformStore store;
+    for (size_t i = 0; i < nodes.size(); i++)
+        store.add(nodes[i].parent, nodes[i].position, nodes[i].rotation, nodes[i].scale);
+
+    vector<glm::mat4> world(nodes.size());
+
+    // every frame spins the chairs, so both paths really recompose every matrix
+    auto start = chrono::high_resolution_clock::now();
+    for (int frame = 0; frame < FRAMES; frame++)
+    {
+        for (size_t i = 0; i < nodes.size(); i += PARTS_PER_CHAIR + 1)
+            nodes[i].rotation.y += 1.0f;
+        composeGlm(nodes, world);
+    }
+    double glmTime = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count() / FRAMES;
+
+    start = chrono::high_resolution_clock::now();
+    for (int frame = 0; frame < FRAMES; frame++)
+    {
+        for (size_t i = 0; i < nodes.size(); i += PARTS_PER_CHAIR + 1)
+            store.setRotation((int)i, nodes[i].rotation - glm::vec3(0.0f, (float)(FRAMES - frame - 1), 0.0f));
+        store.update();
+    }
+    double storeTime = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count() / FRAMES;
+
+    // after the last frame both paths hold the same rotations
+    float maxError = 0.0f;
+    for (size_t i = 0; i < nodes.size(); i++)
+    {
+        glm::mat4 difference = world[i] - store.getWorld((int)i);
+        for (int column = 0; column < 4; column++)
+            for (int row = 0; row < 4; row++)
+                maxError = glm::max(maxError, glm::abs(difference[column][row]));
+    }
+
+    cout << nodes.size() << " nodes, " << TransformLanes::WIDTH << " lane(s) per kernel step" << endl;
+    cout << "glm per object:  " << glmTime << " ms per frame" << endl;
+    cout << "TransformStore:  " << storeTime << " ms per frame (" << glmTime / storeTime << "x)" << endl;
+    cout << "largest difference: " << maxError << endl;
+    return 0;
+}
@@ -0,0 +1,165 @@
+//
+//  affine.h
+//  model matrices without the constant (0, 0, 0, 1) bottom row
+//
+
+#ifndef AFFINE_H
+#define AFFINE_H
+
+#include <cmath>
+#include <glm/glm.hpp>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define AFFINE_SSE 1
+#endif
+
+// the top three rows of an affine mat4. Stored row by row, which is exactly a GLSL mat3x4 whose
+// columns are those rows: shaders transform with vec4(position, 1.0) * model, instance attributes
+// take three vec4 slots and uniform uploads 12 floats instead of 16
+struct Affine
+{
+    glm::vec4 rows[3];
+
+    Affine()
+    {
+        rows[0] = glm::vec4(1.0f, 0.0f, 0.0f, 0.0f);
+        rows[1] = glm::vec4(0.0f, 1.0f, 0.0f, 0.0f);
+        rows[2] = glm::vec4(0.0f, 0.0f, 1.0f, 0.0f);
+    }
+    // drops the bottom row, which must be (0, 0, 0, 1)
+    explicit Affine(const glm::mat4& matrix)
+    {
+        for (int row = 0; row < 3; row++)
+            rows[row] = glm::vec4(matrix[0][row], matrix[1][row], matrix[2][row], matrix[3][row]);
+    }
+
+    glm::mat4 toMat4() const
+    {
+        glm::mat4 matrix(1.0f);
+        for (int row = 0; row < 3; row++)
+            for (int column = 0; column < 4; column++)
+                matrix[column][row] = rows[row][column];
+        return matrix;
+    }
+
+    // 36 multiplies and 27 adds, against 64 and 48 for the full mat4 product
+    Affine operator*(const Affine& other) const
+    {
+        Affine result;
+        for (int row = 0; row < 3; row++)
+        {
+            const glm::vec4& r = rows[row];
+            result.rows[row] = r.x * other.rows[0] + r.y * other.rows[1] + r.z * other.rows[2];
+            result.rows[row].w += r.w;
+        }
+        return result;
+    }
+
+    glm::vec3 transformPoint(const glm::vec3& point) const
+    {
+        glm::vec4 p(point, 1.0f);
+        return glm::vec3(glm::dot(rows[0], p), glm::dot(rows[1], p), glm::dot(rows[2], p));
+    }
+    glm::vec3 transformVector(const glm::vec3& vector) const
+    {
+        glm::vec4 v(vector, 0.0f);
+        return glm::vec3(glm::dot(rows[0], v), glm::dot(rows[1], v), glm::dot(rows[2], v));
+    }
+
+    // inverse transpose of the linear part, computed once per object so the vertex shaders only
+    // multiply by it. Rotation times uniform scale s (rows orthogonal and of equal length) needs no
+    // inverse at all: the result is the linear part over s^2. Anything else uses the cofactors,
+    // whose rows are cross products of the rows, divided by the determinant
+    glm::mat3 normalMatrix() const
+    {
+        float normalRows[3][4];
+#if defined(AFFINE_SSE)
+        __m128 r0 = _mm_loadu_ps(&rows[0][0]);
+        __m128 r1 = _mm_loadu_ps(&rows[1][0]);
+        __m128 r2 = _mm_loadu_ps(&rows[2][0]);
+        float squared[3], skew[3];
+        _mm_store_ss(&squared[0], dot3(r0, r0));
+        _mm_store_ss(&squared[1], dot3(r1, r1));
+        _mm_store_ss(&squared[2], dot3(r2, r2));
+        _mm_store_ss(&skew[0], dot3(r0, r1));
+        _mm_store_ss(&skew[1], dot3(r1, r2));
+        _mm_store_ss(&skew[2], dot3(r2, r0));
+        if (isUniformScale(squared, skew))
+        {
+            __m128 inverseSquared = _mm_set1_ps(1.0f / squared[0]);
+            _mm_storeu_ps(normalRows[0], _mm_mul_ps(r0, inverseSquared));
+            _mm_storeu_ps(normalRows[1], _mm_mul_ps(r1, inverseSquared));
+            _mm_storeu_ps(normalRows[2], _mm_mul_ps(r2, inverseSquared));
+        }
+        else
+        {
+            __m128 c0 = cross3(r1, r2);
+            __m128 determinant = dot3(r0, c0);
+            __m128 inverseDeterminant = _mm_div_ps(_mm_set1_ps(1.0f), _mm_shuffle_ps(determinant, determinant, 0));
+            _mm_storeu_ps(normalRows[0], _mm_mul_ps(c0, inverseDeterminant));
+            _mm_storeu_ps(normalRows[1], _mm_mul_ps(cross3(r2, r0), inverseDeterminant));
+            _mm_storeu_ps(normalRows[2], _mm_mul_ps(cross3(r0, r1), inverseDeterminant));
+        }
+#else
+        glm::vec3 r0(rows[0]), r1(rows[1]), r2(rows[2]);
+        float squared[3] = { glm::dot(r0, r0), glm::dot(r1, r1), glm::dot(r2, r2) };
+        float skew[3] = { glm::dot(r0, r1), glm::dot(r1, r2), glm::dot(r2, r0) };
+        glm::vec3 n0, n1, n2;
+        if (isUniformScale(squared, skew))
+        {
+            n0 = r0 / squared[0];
+            n1 = r1 / squared[0];
+            n2 = r2 / squared[0];
+        }
+        else
+        {
+            n0 = glm::cross(r1, r2);
+            float inverseDeterminant = 1.0f / glm::dot(r0, n0);
+            n0 *= inverseDeterminant;
+            n1 = glm::cross(r2, r0) * inverseDeterminant;
+            n2 = glm::cross(r0, r1) * inverseDeterminant;
+        }
+        for (int column = 0; column < 3; column++)
+        {
+            normalRows[0][column] = n0[column];
+            normalRows[1][column] = n1[column];
+            normalRows[2][column] = n2[column];
+        }
+#endif
+        glm::mat3 normal;
+        for (int row = 0; row < 3; row++)
+            for (int column = 0; column < 3; column++)
+                normal[column][row] = normalRows[row][column];
+        return normal;
+    }
+
+private:
+    // squared row lengths and the dot products of row pairs, both relative to the scale
+    static bool isUniformScale(const float squared[3], const float skew[3])
+    {
+        const float tolerance = 1e-5f * squared[0];
+        return std::fabs(squared[1] - squared[0]) <= tolerance && std::fabs(squared[2] - squared[0]) <= tolerance &&
+            std::fabs(skew[0]) <= tolerance && std::fabs(skew[1]) <= tolerance && std::fabs(skew[2]) <= tolerance;
+    }
+
+#if defined(AFFINE_SSE)
+    // x, y and z only; the translation in w is multiplied away or cancels in the cross product
+    static __m128 dot3(__m128 a, __m128 b)
+    {
+        __m128 product = _mm_mul_ps(a, b);
+        __m128 y = _mm_shuffle_ps(product, product, _MM_SHUFFLE(1, 1, 1, 1));
+        __m128 z = _mm_shuffle_ps(product, product, _MM_SHUFFLE(2, 2, 2, 2));
+        return _mm_add_ss(_mm_add_ss(product, y), z);
+    }
+    static __m128 cross3(__m128 a, __m128 b)
+    {
+        __m128 aYZX = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+        __m128 bYZX = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+        __m128 result = _mm_sub_ps(_mm_mul_ps(a, bYZX), _mm_mul_ps(aYZX, b));
+        return _mm_shuffle_ps(result, result, _MM_SHUFFLE(3, 0, 2, 1));
+    }
+#endif
+};
+
+#endif /* AFFINE_H */
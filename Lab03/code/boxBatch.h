@@ -0,0 +1,167 @@
+//
+//  boxBatch.h
+//  instanced renderer for the scaled unit cubes most scenes are built from
+//
+
+#ifndef BOX_BATCH_H
+#define BOX_BATCH_H
+
+#include <glad/glad.h>
+#include <cstddef>
+#include <vector>
+#include <glm/glm.hpp>
+// Lab02 includes this header after its own shader.h (basic/lab 02 dependencies), whose SHADER_H guard
+// keeps the one next to this file out; only Shader::use() is called here, which both classes have
+#include "shader.h"
+#include "affine.h"
+
+// one box of the frame: unit-cube model matrix plus its Phong material
+// laid out exactly as the per-instance vertex attributes (locations 2-4 and 6-12)
+struct BoxInstance
+{
+    Affine model;           // locations 2-4, a mat3x4 of rows
+    glm::vec3 ambient;      // location 6
+    glm::vec3 diffuse;      // location 7
+    glm::vec3 specular;     // location 8
+    float shininess;        // location 9
+    glm::mat3 normalMatrix; // locations 10-12, one column each
+};
+
+class BoxBatch
+{
+public:
+    // cubeVBO/cubeEBO hold the unit cube with the usual 24 byte position + normal (or color) layout
+    BoxBatch(unsigned int cubeVBO, unsigned int cubeEBO, unsigned int indexCount = 36) : indexCount(indexCount)
+    {
+        glGenVertexArrays(1, &batchVAO);
+        glBindVertexArray(batchVAO);
+
+        // per-vertex cube data, shared with the regular cube VAO
+        glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cubeEBO);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
+
+        // per-instance data, refilled every frame
+        glGenBuffers(1, &instanceVBO);
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        int stride = sizeof(BoxInstance);
+        for (int row = 0; row < 3; row++)
+        {
+            glEnableVertexAttribArray(2 + row);
+            glVertexAttribPointer(2 + row, 4, GL_FLOAT, GL_FALSE, stride, (void*)(offsetof(BoxInstance, model) + sizeof(glm::vec4) * row));
+            glVertexAttribDivisor(2 + row, 1);
+        }
+        glEnableVertexAttribArray(6);
+        glVertexAttribPointer(6, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(BoxInstance, ambient));
+        glVertexAttribDivisor(6, 1);
+        glEnableVertexAttribArray(7);
+        glVertexAttribPointer(7, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(BoxInstance, diffuse));
+        glVertexAttribDivisor(7, 1);
+        glEnableVertexAttribArray(8);
+        glVertexAttribPointer(8, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(BoxInstance, specular));
+        glVertexAttribDivisor(8, 1);
+        glEnableVertexAttribArray(9);
+        glVertexAttribPointer(9, 1, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(BoxInstance, shininess));
+        glVertexAttribDivisor(9, 1);
+        for (int column = 0; column < 3; column++)
+        {
+            glEnableVertexAttribArray(10 + column);
+            glVertexAttribPointer(10 + column, 3, GL_FLOAT, GL_FALSE, stride, (void*)(offsetof(BoxInstance, normalMatrix) + sizeof(glm::vec3) * column));
+            glVertexAttribDivisor(10 + column, 1);
+        }
+
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+    BoxBatch(const BoxBatch&) = delete;
+    BoxBatch& operator=(const BoxBatch&) = delete;
+    ~BoxBatch()
+    {
+        glDeleteVertexArrays(1, &batchVAO);
+        glDeleteBuffers(1, &instanceVBO);
+    }
+
+    // record one box for this frame
+    void add(const glm::mat4& model, const glm::vec3& ambient, const glm::vec3& diffuse, const glm::vec3& specular, float shininess)
+    {
+        add(Affine(model), ambient, diffuse, specular, shininess);
+    }
+    void add(const Affine& model, const glm::vec3& ambient, const glm::vec3& diffuse, const glm::vec3& specular, float shininess)
+    {
+        BoxInstance instance;
+        instance.model = model;
+        instance.ambient = ambient;
+        instance.diffuse = diffuse;
+        instance.specular = specular;
+        instance.shininess = shininess;
+        instance.normalMatrix = model.normalMatrix();
+        instances.push_back(instance);
+    }
+
+    // draw every recorded box with one instanced call and start collecting the next frame
+    // the shader must read the model matrix and material from the instance attributes
+    void draw(Shader& shader)
+    {
+        if (instances.empty())
+            return;
+
+        drawInstances(shader);
+        boxesDrawn += (unsigned int)instances.size();
+        instances.clear();
+        uploaded = false;
+    }
+
+    // the same boxes for a depth pre-pass; they stay recorded, and uploaded, for the draw() that follows
+    void drawDepth(Shader& depthShader)
+    {
+        if (!instances.empty())
+            drawInstances(depthShader);
+    }
+
+    // per-frame statistics
+    void resetStats()
+    {
+        drawCalls = 0;
+        boxesDrawn = 0;
+    }
+    unsigned int getDrawCalls() const
+    {
+        return drawCalls;
+    }
+    unsigned int getBoxesDrawn() const
+    {
+        return boxesDrawn;
+    }
+
+private:
+    void drawInstances(Shader& shader)
+    {
+        shader.use();
+        if (!uploaded)
+        {
+            glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+            // orphan last frame's storage so the upload never waits for the GPU to finish with it
+            glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(BoxInstance), instances.data(), GL_STREAM_DRAW);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            uploaded = true;
+        }
+
+        glBindVertexArray(batchVAO);
+        glDrawElementsInstanced(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0, (GLsizei)instances.size());
+        glBindVertexArray(0);
+        drawCalls++;
+    }
+
+    unsigned int batchVAO;
+    unsigned int instanceVBO;
+    unsigned int indexCount;
+    std::vector<BoxInstance> instances;
+    bool uploaded = false;      // instances already in instanceVBO this frame
+    unsigned int drawCalls = 0;
+    unsigned int boxesDrawn = 0;
+};
+
+#endif /* BOX_BATCH_H */
@@ -0,0 +1,494 @@
+//
+//  bvh.h
+//  bounding volume hierarchy over world space boxes for frustum, ray and proximity queries
+//
+
+#ifndef BVH_H
+#define BVH_H
+
+#include <algorithm>
+#include <vector>
+#include <glm/glm.hpp>
+#include "frustum.h"
+
+struct BvhBox
+{
+    glm::vec3 min = glm::vec3(1.0e30f);
+    glm::vec3 max = glm::vec3(-1.0e30f);
+
+    void grow(const BvhBox& other)
+    {
+        min = glm::min(min, other.min);
+        max = glm::max(max, other.max);
+    }
+    void grow(const glm::vec3& point)
+    {
+        min = glm::min(min, point);
+        max = glm::max(max, point);
+    }
+    float area() const
+    {
+        glm::vec3 d = max - min;
+        if (d.x < 0.0f || d.y < 0.0f || d.z < 0.0f)
+            return 0.0f;
+        return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+    }
+    glm::vec3 center() const
+    {
+        return 0.5f * (min + max);
+    }
+};
+
+struct BvhNode
+{
+    BvhBox bounds;
+    int first = 0;          // leaf: first slot in the object order; inner: left child (right is first + 1)
+    int count = 0;          // objects in a leaf, 0 for inner nodes
+    int parent = -1;
+};
+
+class Bvh
+{
+public:
+    // objects per leaf before the SAH is asked whether splitting pays off
+    static const int MAX_LEAF_SIZE = 4;
+    static const int SAH_BINS = 12;
+
+    // surface area heuristic build over one box per object; object i keeps id i in every query
+    void build(const std::vector<BvhBox>& objectBounds)
+    {
+        boxes = objectBounds;
+        nodes.clear();
+        order.resize(boxes.size());
+        leafOf.assign(boxes.size(), -1);
+        for (size_t i = 0; i < order.size(); i++)
+            order[i] = (int)i;
+        if (boxes.empty())
+            return;
+
+        nodes.reserve(boxes.size() * 2);
+        nodes.push_back(BvhNode());
+        nodes[0].first = 0;
+        nodes[0].count = (int)boxes.size();
+        updateLeafBounds(0);
+        subdivide(0);
+    }
+
+    // move one object; only its leaf and the nodes above it are refit
+    void refit(int object, const BvhBox& bounds)
+    {
+        boxes[object] = bounds;
+        int node = leafOf[object];
+        updateLeafBounds(node);
+        for (node = nodes[node].parent; node >= 0; node = nodes[node].parent)
+        {
+            BvhBox merged = nodes[nodes[node].first].bounds;
+            merged.grow(nodes[nodes[node].first + 1].bounds);
+            nodes[node].bounds = merged;
+        }
+    }
+
+    // every object whose box is at least partly inside the frustum
+    void queryFrustum(const Frustum& frustum, std::vector<int>& result) const
+    {
+        if (nodes.empty())
+            return;
+        std::vector<int> stack(1, 0);
+        while (!stack.empty())
+        {
+            const BvhNode& node = nodes[stack.back()];
+            stack.pop_back();
+            int inside = frustum.classifyBox(node.bounds.min, node.bounds.max);
+            if (inside == Frustum::OUTSIDE)
+                continue;
+            if (inside == Frustum::INSIDE || node.count > 0)
+            {
+                // a fully visible subtree needs no more plane tests
+                if (node.count > 0 && inside == Frustum::INTERSECTS)
+                {
+                    for (int i = node.first; i < node.first + node.count; i++)
+                        if (frustum.boxVisible(boxes[order[i]].min, boxes[order[i]].max))
+                            result.push_back(order[i]);
+                }
+                else
+                    collect(&node - &nodes[0], result);
+                continue;
+            }
+            stack.push_back(node.first);
+            stack.push_back(node.first + 1);
+        }
+    }
+
+    // nearest object box hit by origin + t * direction with t in [0, maxDistance]; -1 when nothing is hit
+    int queryRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float& hitDistance) const
+    {
+        hitDistance = maxDistance;
+        int hit = -1;
+        if (nodes.empty())
+            return hit;
+        glm::vec3 inverse(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+        std::vector<int> stack(1, 0);
+        while (!stack.empty())
+        {
+            const BvhNode& node = nodes[stack.back()];
+            stack.pop_back();
+            float entry;
+            if (!rayHitsBox(origin, inverse, node.bounds, hitDistance, entry))
+                continue;
+            if (node.count > 0)
+            {
+                for (int i = node.first; i < node.first + node.count; i++)
+                {
+                    if (rayHitsBox(origin, inverse, boxes[order[i]], hitDistance, entry))
+                    {
+                        hitDistance = entry;
+                        hit = order[i];
+                    }
+                }
+                continue;
+            }
+            // visit the nearer child first so the far one is usually rejected by hitDistance
+            float leftEntry, rightEntry;
+            bool left = rayHitsBox(origin, inverse, nodes[node.first].bounds, hitDistance, leftEntry);
+            bool right = rayHitsBox(origin, inverse, nodes[node.first + 1].bounds, hitDistance, rightEntry);
+            if (left && right)
+            {
+                bool leftFirst = leftEntry <= rightEntry;
+                stack.push_back(leftFirst ? node.first + 1 : node.first);
+                stack.push_back(leftFirst ? node.first : node.first + 1);
+            }
+            else if (left)
+                stack.push_back(node.first);
+            else if (right)
+                stack.push_back(node.first + 1);
+        }
+        return hit;
+    }
+
+    // every object whose box comes within radius of center
+    void queryRadius(const glm::vec3& center, float radius, std::vector<int>& result) const
+    {
+        if (nodes.empty())
+            return;
+        std::vector<int> stack(1, 0);
+        while (!stack.empty())
+        {
+            const BvhNode& node = nodes[stack.back()];
+            stack.pop_back();
+            if (!sphereHitsBox(center, radius, node.bounds))
+                continue;
+            if (node.count > 0)
+            {
+                for (int i = node.first; i < node.first + node.count; i++)
+                    if (sphereHitsBox(center, radius, boxes[order[i]]))
+                        result.push_back(order[i]);
+                continue;
+            }
+            stack.push_back(node.first);
+            stack.push_back(node.first + 1);
+        }
+    }
+
+    const BvhBox& getBounds(int object) const
+    {
+        return boxes[object];
+    }
+    size_t getObjectCount() const
+    {
+        return boxes.size();
+    }
+    size_t getNodeCount() const
+    {
+        return nodes.size();
+    }
+
+private:
+    void updateLeafBounds(int index)
+    {
+        BvhNode& node = nodes[index];
+        node.bounds = BvhBox();
+        for (int i = node.first; i < node.first + node.count; i++)
+        {
+            node.bounds.grow(boxes[order[i]]);
+            leafOf[order[i]] = index;
+        }
+    }
+
+    // binned SAH split along the axis with the cheapest plane; stays a leaf when no split beats it
+    void subdivide(int index)
+    {
+        int first = nodes[index].first;
+        int count = nodes[index].count;
+        if (count <= MAX_LEAF_SIZE)
+            return;
+
+        BvhBox centroids;
+        for (int i = first; i < first + count; i++)
+            centroids.grow(boxes[order[i]].center());
+
+        float bestCost = 1.0e30f;
+        int bestAxis = -1;
+        int bestSplit = 0;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            float low = centroids.min[axis];
+            float extent = centroids.max[axis] - low;
+            if (extent <= 0.0f)
+                continue;
+
+            BvhBox binBounds[SAH_BINS];
+            int binCount[SAH_BINS] = { 0 };
+            float scale = SAH_BINS / extent;
+            for (int i = first; i < first + count; i++)
+            {
+                const BvhBox& box = boxes[order[i]];
+                int bin = std::min(SAH_BINS - 1, (int)((box.center()[axis] - low) * scale));
+                binCount[bin]++;
+                binBounds[bin].grow(box);
+            }
+
+            // sweep from both sides: cost of splitting after bin b is leftArea * leftCount + rightArea * rightCount
+            float rightArea[SAH_BINS];
+            int rightCount[SAH_BINS];
+            BvhBox sweep;
+            int sweepCount = 0;
+            for (int b = SAH_BINS - 1; b > 0; b--)
+            {
+                sweep.grow(binBounds[b]);
+                sweepCount += binCount[b];
+                rightArea[b] = sweep.area();
+                rightCount[b] = sweepCount;
+            }
+            sweep = BvhBox();
+            sweepCount = 0;
+            for (int b = 0; b < SAH_BINS - 1; b++)
+            {
+                sweep.grow(binBounds[b]);
+                sweepCount += binCount[b];
+                if (sweepCount == 0 || rightCount[b + 1] == 0)
+                    continue;
+                float cost = sweep.area() * sweepCount + rightArea[b + 1] * rightCount[b + 1];
+                if (cost < bestCost)
+                {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestSplit = b;
+                }
+            }
+        }
+
+        if (bestAxis < 0 || bestCost >= nodes[index].bounds.area() * count)
+        {
+            if (bestAxis < 0)
+                return;     // every centroid coincides; nothing to split on
+            // the SAH says one big leaf is cheaper, but huge leaves make refits and culling coarse
+            if (count <= MAX_LEAF_SIZE * 4)
+                return;
+        }
+
+        float low = centroids.min[bestAxis];
+        float scale = SAH_BINS / (centroids.max[bestAxis] - low);
+        int* middle = std::partition(&order[first], &order[first] + count, [&](int object)
+            {
+                int bin = std::min(SAH_BINS - 1, (int)((boxes[object].center()[bestAxis] - low) * scale));
+                return bin <= bestSplit;
+            });
+        int leftCount = (int)(middle - &order[first]);
+        if (leftCount == 0 || leftCount == count)
+            return;
+
+        int left = (int)nodes.size();
+        nodes.push_back(BvhNode());
+        nodes.push_back(BvhNode());
+        nodes[left].first = first;
+        nodes[left].count = leftCount;
+        nodes[left].parent = index;
+        nodes[left + 1].first = first + leftCount;
+        nodes[left + 1].count = count - leftCount;
+        nodes[left + 1].parent = index;
+        nodes[index].first = left;
+        nodes[index].count = 0;
+
+        updateLeafBounds(left);
+        updateLeafBounds(left + 1);
+        subdivide(left);
+        subdivide(left + 1);
+    }
+
+    // every object below a node
+    void collect(ptrdiff_t index, std::vector<int>& result) const
+    {
+        const BvhNode& node = nodes[index];
+        if (node.count > 0)
+        {
+            for (int i = node.first; i < node.first + node.count; i++)
+                result.push_back(order[i]);
+            return;
+        }
+        collect(node.first, result);
+        collect(node.first + 1, result);
+    }
+
+    static bool rayHitsBox(const glm::vec3& origin, const glm::vec3& inverse, const BvhBox& box, float maxDistance, float& entry)
+    {
+        float entryDistance = 0.0f;
+        float exitDistance = maxDistance;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            float t0 = (box.min[axis] - origin[axis]) * inverse[axis];
+            float t1 = (box.max[axis] - origin[axis]) * inverse[axis];
+            entryDistance = std::max(entryDistance, std::min(t0, t1));
+            exitDistance = std::min(exitDistance, std::max(t0, t1));
+        }
+        entry = entryDistance;
+        return entryDistance <= exitDistance;
+    }
+
+    static bool sphereHitsBox(const glm::vec3& center, float radius, const BvhBox& box)
+    {
+        glm::vec3 closest = glm::clamp(center, box.min, box.max);
+        glm::vec3 d = center - closest;
+        return glm::dot(d, d) <= radius * radius;
+    }
+
+    std::vector<BvhBox> boxes;      // per object
+    std::vector<int> leafOf;        // per object
+    std::vector<int> order;         // objects grouped by leaf
+    std::vector<BvhNode> nodes;     // root first
+};
+
+// the drawables of an immediate mode scene, identified by the order they are drawn in each frame.
+// the first frame records every world box and builds the tree; later frames answer the frustum test
+// from one traversal and refit only the objects whose model matrix changed (fan blades, door)
+class SceneBvh
+{
+public:
+    static SceneBvh& current()
+    {
+        static SceneBvh scene;
+        return scene;
+    }
+
+    // after Frustum::update, before the first draw
+    void beginFrame(const Frustum& frustum)
+    {
+        cursor = 0;
+        refits = 0;
+        std::fill(inFrustum.begin(), inFrustum.end(), (char)0);
+        if (dirty)
+            return;
+        visibleObjects.clear();
+        bvh.queryFrustum(frustum, visibleObjects);
+        for (size_t i = 0; i < visibleObjects.size(); i++)
+            inFrustum[visibleObjects[i]] = 1;
+    }
+
+    // drop-in for Frustum::isVisible; objects that moved are refit and tested directly
+    bool isVisible(const glm::mat4& model, const glm::vec3& boxMin, const glm::vec3& boxMax)
+    {
+        Frustum& frustum = Frustum::current();
+        int object = cursor++;
+        if (object >= (int)objects.size())
+        {
+            objects.push_back(SceneObject());
+            inFrustum.push_back(0);
+            dirty = true;
+        }
+
+        SceneObject& entry = objects[object];
+        if (dirty || entry.model != model || entry.boxMin != boxMin || entry.boxMax != boxMax)
+        {
+            entry.model = model;
+            entry.boxMin = boxMin;
+            entry.boxMax = boxMax;
+            entry.bounds = worldBox(model, boxMin, boxMax);
+            if (!dirty)
+            {
+                bvh.refit(object, entry.bounds);
+                refits++;
+            }
+            return frustum.isVisible(model, boxMin, boxMax);
+        }
+
+        bool inside = inFrustum[object] != 0;
+        frustum.addStats(inside ? 1 : 0, inside ? 0 : 1);
+        return inside;
+    }
+
+    // after the last draw; rebuilds when the scene drew a different number of objects
+    void endFrame()
+    {
+        if (cursor != (int)objects.size())
+        {
+            objects.resize(cursor);
+            inFrustum.resize(cursor);
+            dirty = true;
+        }
+        if (!dirty)
+            return;
+        std::vector<BvhBox> bounds(objects.size());
+        for (size_t i = 0; i < objects.size(); i++)
+            bounds[i] = objects[i].bounds;
+        bvh.build(bounds);
+        dirty = false;
+        builds++;
+    }
+
+    // object nearest along the ray, -1 for none
+    int pick(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float& hitDistance) const
+    {
+        return bvh.queryRay(origin, direction, maxDistance, hitDistance);
+    }
+    void nearby(const glm::vec3& center, float radius, std::vector<int>& result) const
+    {
+        bvh.queryRadius(center, radius, result);
+    }
+
+    const Bvh& getBvh() const
+    {
+        return bvh;
+    }
+    unsigned int getRefits() const
+    {
+        return refits;
+    }
+    unsigned int getBuilds() const
+    {
+        return builds;
+    }
+
+    // world AABB of an object space box under model: |M| * extent (Arvo)
+    static BvhBox worldBox(const glm::mat4& model, const glm::vec3& boxMin, const glm::vec3& boxMax)
+    {
+        glm::vec3 center = glm::vec3(model * glm::vec4(0.5f * (boxMin + boxMax), 1.0f));
+        glm::vec3 localExtent = 0.5f * (boxMax - boxMin);
+        glm::mat3 linear(model);
+        glm::vec3 extent(0.0f);
+        for (int column = 0; column < 3; column++)
+            extent += glm::abs(linear[column]) * localExtent[column];
+        BvhBox box;
+        box.min = center - extent;
+        box.max = center + extent;
+        return box;
+    }
+
+private:
+    struct SceneObject
+    {
+        glm::mat4 model;
+        glm::vec3 boxMin;
+        glm::vec3 boxMax;
+        BvhBox bounds;
+    };
+
+    Bvh bvh;
+    std::vector<SceneObject> objects;   // in draw order
+    std::vector<char> inFrustum;        // per object, from this frame's traversal
+    std::vector<int> visibleObjects;
+    int cursor = 0;
+    bool dirty = true;                  // tree does not match objects yet
+    unsigned int refits = 0;            // this frame
+    unsigned int builds = 0;
+};
+
+#endif /* BVH_H */
@@ -9,11 +9,14 @@
 #define cone_h
 
 #include <glad/glad.h>
+#include <algorithm>
 #include <vector>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include "shader.h"
+#include "meshCache.h"
+#include "materialTable.h"
 
 # define PI 3.1416
 
@@ -33,43 +36,19 @@ public:
     Cone(float radius = 1.0f, int sectorCount = 36, int stackCount = 18, glm::vec3 amb = glm::vec3(0.98, 0.847, 0.69), glm::vec3 diff = glm::vec3(0.0, 0.847, 0.69), glm::vec3 spec = glm::vec3(0.5f, 0.5f, 0.5f), float shiny = 32.0f) : verticesStride(24)
     {
         set(radius, sectorCount, stackCount, amb, diff, spec, shiny);
-        buildCoordinatesAndIndices();
-        buildVertices();
-
-        glGenVertexArrays(1, &coneVAO);
-        glBindVertexArray(coneVAO);
-
-        // create VBO to copy vertex data to VBO
-        unsigned int coneVBO;
-        glGenBuffers(1, &coneVBO);
-        glBindBuffer(GL_ARRAY_BUFFER, coneVBO);           // for vertex data
-        glBufferData(GL_ARRAY_BUFFER,                   // target
-            this->getVertexSize(), // data size, # of bytes
-            this->getVertices(),   // ptr to vertex data
-            GL_STATIC_DRAW);                   // usage
-
-        // create EBO to copy index data
-        unsigned int coneEBO;
-        glGenBuffers(1, &coneEBO);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, coneEBO);   // for index data
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER,           // target
-            this->getIndexSize(),             // data size, # of bytes
-            this->getIndices(),               // ptr to index data
-            GL_STATIC_DRAW);                   // usage
-
-        // activate attrib arrays
-        glEnableVertexAttribArray(0);
-        glEnableVertexAttribArray(1);
-
-        // set attrib arrays with stride and offset
-        int stride = this->getVerticesStride();     // should be 24 bytes
-        glVertexAttribPointer(0, 3, GL_FLOAT, false, stride, (void*)0);
-        glVertexAttribPointer(1, 3, GL_FLOAT, false, stride, (void*)(sizeof(float) * 3));
-
-        // unbind VAO and VBOs
-        glBindVertexArray(0);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+        // one tessellation per LOD level, each shared with every cone of the same radius and sector count (stacks are not used)
+        for (int level = 0; level < MAX_LOD_LEVELS; level++)
+        {
+            int sectors = max(this->sectorCount >> level, MIN_SECTOR_COUNT);
+            lods[level] = MeshCache::instance().acquire(MeshKey(SHAPE_CONE, this->radius, 0.0f, 0.0f, sectors, 0),
+                [this, sectors](vector<float>& vertices, vector<unsigned int>& indices)
+                {
+                    vector<float> coordinates, normals;
+                    buildCoordinatesAndIndices(sectors, coordinates, normals, indices);
+                    buildVertices(coordinates, normals, vertices);
+                });
+        }
     }
     ~Cone() {}
 
@@ -112,12 +91,12 @@ public:
     // for interleaved vertices
     unsigned int getVertexCount() const
     {
-        return (unsigned int)coordinates.size() / 3;     // # of vertices
+        return (unsigned int)lods[0]->vertices.size() / 6;  // # of vertices
     }
 
     unsigned int getVertexSize() const
     {
-        return (unsigned int)vertices.size() * sizeof(float);  // # of bytes
+        return (unsigned int)lods[0]->vertices.size() * sizeof(float);  // # of bytes
     }
 
     int getVerticesStride() const
@@ -126,50 +105,50 @@ public:
     }
     const float* getVertices() const
     {
-        return vertices.data();
+        return lods[0]->vertices.data();
     }
 
     unsigned int getIndexSize() const
     {
-        return (unsigned int)indices.size() * sizeof(unsigned int);
+        return (unsigned int)lods[0]->indices.size() * sizeof(unsigned int);
     }
 
     const unsigned int* getIndices() const
     {
-        return indices.data();
+        return lods[0]->indices.data();
     }
 
     unsigned int getIndexCount() const
     {
-        return (unsigned int)indices.size();
+        return (unsigned int)lods[0]->indices.size();
+    }
+
+    // where the full detail cone lives in the mesh arena, for multi-draw lists
+    const MeshRange& getMeshRange() const
+    {
+        return lods[0]->range;
     }
 
     // draw in VertexArray mode
-    void drawCone(Shader& lightingShader, glm::mat4 model) const      // draw surface
+    void drawCone(Shader& lightingShader, glm::mat4 model, LodState* lod = nullptr) const      // draw surface
     {
-        lightingShader.use();
+        if (!meshVisible(*lods[0], model))
+            return;
 
-        lightingShader.setVec3("material.ambient", this->ambient);
-        lightingShader.setVec3("material.diffuse", this->diffuse);
-        lightingShader.setVec3("material.specular", this->specular);
-        lightingShader.setFloat("material.shininess", this->shininess);
+        lightingShader.use();
 
-        lightingShader.setMat4("model", model);
+        int material = MaterialTable::current().index(this->ambient, this->diffuse, this->specular, this->shininess);
+        lightingShader.setInt(lightingShader.materialUniforms.materialIndex, material);
 
-        // draw a cone with VAO
-        glBindVertexArray(coneVAO);
-        glDrawElements(GL_TRIANGLES,                    // primitive type
-            this->getIndexCount(),          // # of indices
-            GL_UNSIGNED_INT,                 // data type
-            (void*)0);                       // offset to indices
+        lightingShader.setModel(Affine(model));
 
-        // unbind VAO
-        glBindVertexArray(0);
+        // draw the tessellation that matches the cone's size on screen
+        selectLod(lods, model, lod).draw(lightingShader);
     }
 
 private:
     // member functions
-    void buildCoordinatesAndIndices()
+    void buildCoordinatesAndIndices(int sectorCount, vector<float>& coordinates, vector<float>& normals, vector<unsigned int>& indices)
     {
         float height = 2.0;
         float sectorStep = 2 * PI / sectorCount;  // Step size for sector
@@ -250,7 +229,7 @@ private:
         //}
     }
 
-    void buildVertices()
+    void buildVertices(const vector<float>& coordinates, const vector<float>& normals, vector<float>& vertices)
     {
         size_t i, j;
         size_t count = coordinates.size();
@@ -301,14 +280,10 @@ private:
     }
 
     // memeber vars
-    unsigned int coneVAO;
+    shared_ptr<const ParametricMesh> lods[MAX_LOD_LEVELS];  // shared geometry, finest first, see meshCache.h
     float radius;
     int sectorCount;                        // longitude, # of slices
     int stackCount;                         // latitude, # of stacks
-    vector<float> vertices;
-    vector<float> normals;
-    vector<unsigned int> indices;
-    vector<float> coordinates;
     int verticesStride;                 // # of bytes to hop to the next vertex (should be 24 bytes)
 
 };
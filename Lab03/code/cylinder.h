@@ -2,11 +2,14 @@
 #define CYLINDER_H
 
 #include <glad/glad.h>
+#include <algorithm>
 #include <vector>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include "shader.h"
+#include "meshCache.h"
+#include "materialTable.h"
 
 #define PI 3.1416
 
@@ -25,35 +28,17 @@ public:
         float shiny = 32.0f)
         : verticesStride(24) {
         set(baseRadius, topRadius, height, sectorCount, amb, diff, spec, shiny);
-        buildCoordinatesAndIndices();
-        buildVertices();
-
-        glGenVertexArrays(1, &cylinderVAO);
-        glBindVertexArray(cylinderVAO);
-
-        // Vertex Buffer Object (VBO)
-        unsigned int cylinderVBO;
-        glGenBuffers(1, &cylinderVBO);
-        glBindBuffer(GL_ARRAY_BUFFER, cylinderVBO);
-        glBufferData(GL_ARRAY_BUFFER, getVertexSize(), getVertices(), GL_STATIC_DRAW);
-
-        // Element Buffer Object (EBO)
-        unsigned int cylinderEBO;
-        glGenBuffers(1, &cylinderEBO);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cylinderEBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, getIndexSize(), getIndices(), GL_STATIC_DRAW);
-
-        // Vertex Attribute Pointers
-        glEnableVertexAttribArray(0);
-        glEnableVertexAttribArray(1);
-        int stride = getVerticesStride();
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);               // Position
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * 3)); // Normal
-
-        // Unbind
-        glBindVertexArray(0);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+        // One tessellation per LOD level, each shared with every cylinder of the same radii, height and sector count
+        for (int level = 0; level < MAX_LOD_LEVELS; level++) {
+            int sectors = std::max(this->sectorCount >> level, 3);
+            lods[level] = MeshCache::instance().acquire(MeshKey(SHAPE_CYLINDER, this->baseRadius, this->topRadius, this->height, sectors, 0),
+                [this, sectors](std::vector<float>& vertices, std::vector<unsigned int>& indices) {
+                    std::vector<float> coordinates, normals;
+                    buildCoordinatesAndIndices(sectors, coordinates, normals, indices);
+                    buildVertices(coordinates, normals, vertices);
+                });
+        }
     }
 
     // Destructor
@@ -71,34 +56,46 @@ public:
         this->shininess = shiny;
     }
 
+    // Location of the full detail mesh in the arena, for multi-draw lists
+    const MeshRange& getMeshRange() const { return lods[0]->range; }
+
+    // Every LOD level, finest first, for baking static copies into a StaticMeshGroup
+    const std::shared_ptr<const ParametricMesh>* getLods() const { return lods; }
+
+    // Full detail mesh, for its object space bounds
+    const ParametricMesh& getMesh() const { return *lods[0]; }
+
     // Draw the cylinder
-    void drawCylinder(Shader& lightingShader, glm::mat4 model) const {
+    void drawCylinder(Shader& lightingShader, glm::mat4 model, LodState* lod = nullptr) const {
+        if (!meshVisible(*lods[0], model))
+            return;
         lightingShader.use();
 
-        lightingShader.setVec3("material.ambient", this->ambient);
-        lightingShader.setVec3("material.diffuse", this->diffuse);
-        lightingShader.setVec3("material.specular", this->specular);
-        lightingShader.setFloat("material.shininess", this->shininess);
+        int material = MaterialTable::current().index(this->ambient, this->diffuse, this->specular, this->shininess);
+        lightingShader.setInt(lightingShader.materialUniforms.materialIndex, material);
+
+        lightingShader.setModel(Affine(model));
 
-        lightingShader.setMat4("model", model);
+        // Tessellation that matches the cylinder's size on screen
+        selectLod(lods, model, lod).draw(lightingShader);
+    }
 
-        glBindVertexArray(cylinderVAO);
-        glDrawElements(GL_TRIANGLES, getIndexCount(), GL_UNSIGNED_INT, (void*)0);
-        glBindVertexArray(0);
+    // Draw static copies of this cylinder baked into group, all with its material
+    void drawGroup(Shader& lightingShader, StaticMeshGroup& group, LodState* states = nullptr) const {
+        lightingShader.use();
+        int material = MaterialTable::current().index(this->ambient, this->diffuse, this->specular, this->shininess);
+        lightingShader.setInt(lightingShader.materialUniforms.materialIndex, material);
+        group.draw(lightingShader, states);
     }
 
 private:
-    unsigned int cylinderVAO;
+    std::shared_ptr<const ParametricMesh> lods[MAX_LOD_LEVELS];  // Shared geometry, finest first, see meshCache.h
     float baseRadius, topRadius, height;
     int sectorCount;
-    std::vector<float> vertices;
-    std::vector<float> normals;
-    std::vector<unsigned int> indices;
-    std::vector<float> coordinates;
     int verticesStride;
 
     // Build vertices and normals
-    void buildCoordinatesAndIndices() {
+    void buildCoordinatesAndIndices(int sectorCount, std::vector<float>& coordinates, std::vector<float>& normals, std::vector<unsigned int>& indices) {
         float sectorStep = 2 * PI / sectorCount;
         float sectorAngle;
 
@@ -159,7 +156,7 @@ private:
         }
     }
 
-    void buildVertices() {
+    void buildVertices(const std::vector<float>& coordinates, const std::vector<float>& normals, std::vector<float>& vertices) {
         for (size_t i = 0; i < coordinates.size(); i += 3) {
             vertices.push_back(coordinates[i]);
             vertices.push_back(coordinates[i + 1]);
@@ -171,11 +168,11 @@ private:
         }
     }
 
-    unsigned int getVertexSize() const { return (unsigned int)vertices.size() * sizeof(float); }
-    unsigned int getIndexSize() const { return (unsigned int)indices.size() * sizeof(unsigned int); }
-    const float* getVertices() const { return vertices.data(); }
-    const unsigned int* getIndices() const { return indices.data(); }
-    unsigned int getIndexCount() const { return (unsigned int)indices.size(); }
+    unsigned int getVertexSize() const { return (unsigned int)lods[0]->vertices.size() * sizeof(float); }
+    unsigned int getIndexSize() const { return (unsigned int)lods[0]->indices.size() * sizeof(unsigned int); }
+    const float* getVertices() const { return lods[0]->vertices.data(); }
+    const unsigned int* getIndices() const { return lods[0]->indices.data(); }
+    unsigned int getIndexCount() const { return (unsigned int)lods[0]->indices.size(); }
     int getVerticesStride() const { return verticesStride; }
 };
 
@@ -0,0 +1,123 @@
+//
+//  depthPrepass.h
+//  depth-only pass ahead of the lit boxes so each covered pixel runs the Phong shader once
+//
+
+#ifndef DEPTH_PREPASS_H
+#define DEPTH_PREPASS_H
+
+#include <glad/glad.h>
+
+enum DepthPrepassMode
+{
+    DEPTH_PREPASS_OFF,
+    DEPTH_PREPASS_ON,
+    DEPTH_PREPASS_AUTO      // on while the measured overdraw is high
+};
+
+// the pre-pass lays down depth with the color writes masked, then the shading pass draws the same geometry
+// with GL_EQUAL and depth writes off; both must use the same vertex transform and an invariant gl_Position
+//
+// overdraw is counted with GL_SAMPLES_PASSED around whichever pass tests with GL_LESS: the shading pass
+// without a pre-pass, the pre-pass itself with one. Both count the fragments a plain forward pass would
+// shade, so the heuristic reads the same number either way. Two queries are used in turns, like GpuTimer
+class DepthPrepass
+{
+public:
+    DepthPrepassMode mode = DEPTH_PREPASS_AUTO;
+
+    // fragments per pixel above which auto mode turns the pre-pass on, and below which it turns it off again
+    static constexpr double ENABLE_OVERDRAW = 1.5;
+    static constexpr double DISABLE_OVERDRAW = 1.25;
+
+    bool isActive() const
+    {
+        return mode == DEPTH_PREPASS_ON || (mode == DEPTH_PREPASS_AUTO && autoActive);
+    }
+
+    // depth only: no color writes, fragments counted
+    void beginDepthPass()
+    {
+        beginQuery();
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        depthPassRan = true;
+    }
+
+    // after a depth pass, only the nearest fragment of each pixel passes; without one, this pass is counted
+    void beginShadingPass()
+    {
+        if (depthPassRan)
+        {
+            glEndQuery(GL_SAMPLES_PASSED);
+            glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+            glDepthFunc(GL_EQUAL);
+            glDepthMask(GL_FALSE);
+        }
+        else
+            beginQuery();
+    }
+
+    // back to the default depth state; pixels is the framebuffer area the count is divided by
+    void endShadingPass(int pixels)
+    {
+        if (depthPassRan)
+        {
+            glDepthFunc(GL_LESS);
+            glDepthMask(GL_TRUE);
+        }
+        else
+            glEndQuery(GL_SAMPLES_PASSED);
+        depthPassRan = false;
+        issued[current] = true;
+        current = 1 - current;
+
+        // last frame's count, if the GPU already has it
+        if (issued[current])
+        {
+            GLint available = 0;
+            glGetQueryObjectiv(queries[current], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available)
+            {
+                GLuint samples = 0;
+                glGetQueryObjectuiv(queries[current], GL_QUERY_RESULT, &samples);
+                issued[current] = false;
+                overdraw = pixels > 0 ? (double)samples / pixels : 0.0;
+                if (overdraw > ENABLE_OVERDRAW)
+                    autoActive = true;
+                else if (overdraw < DISABLE_OVERDRAW)
+                    autoActive = false;
+            }
+        }
+    }
+
+    void release()
+    {
+        if (queries[0] != 0)
+            glDeleteQueries(2, queries);
+        queries[0] = queries[1] = 0;
+        issued[0] = issued[1] = false;
+    }
+
+    // depth-tested fragments per framebuffer pixel, from the most recent completed count
+    double getOverdraw() const
+    {
+        return overdraw;
+    }
+
+private:
+    void beginQuery()
+    {
+        if (queries[0] == 0)
+            glGenQueries(2, queries);
+        glBeginQuery(GL_SAMPLES_PASSED, queries[current]);
+    }
+
+    unsigned int queries[2] = { 0, 0 };
+    bool issued[2] = { false, false };
+    int current = 0;
+    bool depthPassRan = false;
+    bool autoActive = false;
+    double overdraw = 0.0;
+};
+
+#endif /* DEPTH_PREPASS_H */
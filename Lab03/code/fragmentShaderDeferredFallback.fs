@@ -0,0 +1,27 @@
+#version 330 core
+// stand-in for the deferred lighting pass while its variant is still compiling (see shaderVariants.h): the
+// G-buffer's diffuse color under a fixed light, no light loops
+out vec4 FragColor;
+
+uniform sampler2D gNormal;
+uniform sampler2D gDiffuse;
+uniform sampler2D gDepth;
+
+// same octahedral decoding as fragmentShaderDeferredLighting.fs
+vec3 DecodeNormal(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if(n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    if(texelFetch(gDepth, pixel, 0).r == 1.0)
+        discard;    // background: keep the clear color
+    vec3 N = DecodeNormal(texelFetch(gNormal, pixel, 0).xy);
+    float shade = 0.4 + 0.6 * max(dot(N, normalize(vec3(0.3, 1.0, 0.5))), 0.0);
+    FragColor = vec4(texelFetch(gDiffuse, pixel, 0).rgb * shade, 1.0);
+}
@@ -0,0 +1,207 @@
+#version 330 core
+// lighting pass of the deferred path (see gBuffer.h): every light evaluated once per covered pixel
+out vec4 FragColor;
+
+struct Material {
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+    float shininess;
+};
+
+struct DirectionalLight {
+    vec3 direction;
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+// point, spot and directional lights live in std140 uniform buffers filled by LightManager (see
+// lightManager.h); the members are ordered so every vec3 shares its 16 byte slot with a float
+struct PointLight {
+    vec3 position;
+    float k_c;  // attenuation factors
+    vec3 ambient;
+    float k_l;  // attenuation factors
+    vec3 diffuse;
+    float k_q;  // attenuation factors
+    vec3 specular;
+};
+
+struct SpotLight {
+    vec3 position;
+    float k_c;  // attenuation factors
+    vec3 direction;
+    float cutOff;
+    vec3 ambient;
+    float k_l;  // attenuation factors
+    vec3 diffuse;
+    float k_q;  // attenuation factors
+    vec3 specular;
+    float outerCutOff;
+};
+
+#define MAX_POINT_LIGHTS 255
+#define MAX_SPOT_LIGHTS 128
+
+layout (std140) uniform PointLights {
+    int pointLightCount;
+    PointLight pointLights[MAX_POINT_LIGHTS];
+};
+
+layout (std140) uniform SpotLights {
+    int spotLightCount;
+    SpotLight spotLights[MAX_SPOT_LIGHTS];
+};
+
+layout (std140) uniform DirectionalLightBlock {
+    DirectionalLight directionalLight;
+};
+
+layout (std140) uniform Frame {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+};
+
+// G-buffer targets, read one texel per pixel
+uniform sampler2D gNormal;
+uniform sampler2D gDiffuse;
+uniform sampler2D gAmbient;
+uniform sampler2D gSpecular;
+uniform sampler2D gDepth;
+uniform mat4 inverseProjectionView;     // NDC back to world space
+
+// clustered lighting (see lightClusters.h): only the lights reaching this pixel's cluster; clusterViewport
+// also maps pixels back to NDC
+const ivec3 clusterGrid = ivec3(16, 9, 24);     // CLUSTER_X, CLUSTER_Y, CLUSTER_Z
+uniform bool clusteredLighting = false;
+uniform usamplerBuffer clusterTable;            // per cluster: first index, point count | spot count << 16
+uniform usamplerBuffer clusterLightIndices;     // indices into pointLights, then spotLights
+uniform vec2 clusterViewport;
+uniform float clusterDepthScale;                // slice = log(view depth) * scale - bias
+uniform float clusterDepthBias;
+
+// permutations (see shaderVariants.h): NO_DIRECTIONAL_LIGHT, NO_SPOT_LIGHTS, NO_AMBIENT, NO_DIFFUSE and
+// NO_SPECULAR compile switched-off lights and terms out instead of weighting them with zero
+
+// function prototypes
+vec3 CalcTerms(Material material, vec3 lightAmbient, vec3 lightDiffuse, vec3 lightSpecular, vec3 N, vec3 L, vec3 V);
+vec3 CalcPointLight(Material material, PointLight light, vec3 N, vec3 fragPos, vec3 V);
+vec3 CalcDirectionalLight(Material material, DirectionalLight light, vec3 N, vec3 V);
+vec3 CalcSpotLight(Material material, SpotLight light, vec3 N, vec3 fragPos, vec3 V);
+
+vec3 DecodeNormal(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if(n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    float sceneDepth = texelFetch(gDepth, pixel, 0).r;
+    if(sceneDepth == 1.0)
+        discard;    // background: keep the clear color
+
+    vec4 world = inverseProjectionView * vec4(gl_FragCoord.xy / clusterViewport * 2.0 - 1.0, sceneDepth * 2.0 - 1.0, 1.0);
+    vec3 FragPos = world.xyz / world.w;
+    vec4 normalShininess = texelFetch(gNormal, pixel, 0);
+    Material material = Material(texelFetch(gAmbient, pixel, 0).rgb, texelFetch(gDiffuse, pixel, 0).rgb,
+                                 texelFetch(gSpecular, pixel, 0).rgb, normalShininess.z);
+    vec3 N = DecodeNormal(normalShininess.xy);
+    vec3 V = normalize(viewPos - FragPos);
+    
+    vec3 result = vec3(0.0);
+    if(clusteredLighting)
+    {
+        float depth = -(view * vec4(FragPos, 1.0)).z;
+        ivec3 cell = ivec3(ivec2(gl_FragCoord.xy / clusterViewport * vec2(clusterGrid.xy)),
+                           int(floor(log(depth) * clusterDepthScale - clusterDepthBias)));
+        cell = clamp(cell, ivec3(0), clusterGrid - 1);
+        uvec2 entry = texelFetch(clusterTable, cell.x + clusterGrid.x * (cell.y + clusterGrid.y * cell.z)).xy;
+        int first = int(entry.x);
+        int points = int(entry.y & 0xFFFFu);
+        int spots = int(entry.y >> 16);
+        for(int i = 0; i < points; i++)
+            result += CalcPointLight(material, pointLights[int(texelFetch(clusterLightIndices, first + i).r)], N, FragPos, V);
+#ifndef NO_SPOT_LIGHTS
+        for(int i = 0; i < spots; i++)
+            result += CalcSpotLight(material, spotLights[int(texelFetch(clusterLightIndices, first + points + i).r)], N, FragPos, V);
+#endif
+    }
+    else
+    {
+        // point lights
+        for(int i = 0; i < pointLightCount; i++){
+            result += CalcPointLight(material, pointLights[i], N, FragPos, V);
+        }
+        // spot lights
+#ifndef NO_SPOT_LIGHTS
+        for(int i = 0; i < spotLightCount; i++)
+        {
+            result += CalcSpotLight(material, spotLights[i], N, FragPos, V);
+        }
+#endif
+    }
+    // directional light
+#ifndef NO_DIRECTIONAL_LIGHT
+    result += CalcDirectionalLight(material, directionalLight, N, V);
+#endif
+
+    FragColor = vec4(result, 1.0);
+}
+
+// the Phong terms this permutation keeps, before attenuation
+vec3 CalcTerms(Material material, vec3 lightAmbient, vec3 lightDiffuse, vec3 lightSpecular, vec3 N, vec3 L, vec3 V)
+{
+    vec3 color = vec3(0.0);
+#ifndef NO_AMBIENT
+    color += material.ambient * lightAmbient;
+#endif
+#ifndef NO_DIFFUSE
+    color += material.diffuse * max(dot(N, L), 0.0) * lightDiffuse;
+#endif
+#ifndef NO_SPECULAR
+    vec3 R = reflect(-L, N);
+    color += material.specular * pow(max(dot(V, R), 0.0), material.shininess) * lightSpecular;
+#endif
+    return color;
+}
+
+// calculates the color when using a point light.
+vec3 CalcPointLight(Material material, PointLight light, vec3 N, vec3 fragPos, vec3 V)
+{
+    vec3 L = normalize(light.position - fragPos);
+    
+    // attenuation
+    float d = length(light.position - fragPos);
+    float attenuation = 1.0 / (light.k_c + light.k_l * d + light.k_q * (d * d));
+    
+    return CalcTerms(material, light.ambient, light.diffuse, light.specular, N, L, V) * attenuation;
+}
+
+vec3 CalcDirectionalLight(Material material, DirectionalLight light, vec3 N, vec3 V)
+{
+    vec3 L = normalize(-light.direction);
+    
+    return CalcTerms(material, light.ambient, light.diffuse, light.specular, N, L, V);
+}
+
+vec3 CalcSpotLight(Material material, SpotLight light, vec3 N, vec3 fragPos, vec3 V)
+{
+    vec3 L = normalize(light.position - fragPos);
+    
+    // attenuation
+    float d = length(light.position - fragPos);
+    float attenuation = 1.0 / (light.k_c + light.k_l * d + light.k_q * (d * d));
+
+    float cos_alpha = dot(L, normalize(-light.direction));
+    float cos_theta = light.cutOff- light.outerCutOff;
+
+    float intensity = clamp((cos_alpha-light.outerCutOff)/cos_theta, 0.0, 1.0); 
+
+    return CalcTerms(material, light.ambient, light.diffuse, light.specular, N, L, V) * (attenuation * intensity);
+}
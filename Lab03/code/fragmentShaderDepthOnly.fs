@@ -0,0 +1,6 @@
+#version 330 core
+// depth pre-pass (see depthPrepass.h): color writes are masked, only the depth test runs
+
+void main()
+{
+}
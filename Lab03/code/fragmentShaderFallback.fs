@@ -0,0 +1,13 @@
+#version 330 core
+// stand-in for the lit programs while they are still compiling (see shaderVariants.h): the material's
+// diffuse color under a fixed light, no light loops
+out vec4 FragColor;
+
+in vec3 Normal;
+flat in vec3 MaterialDiffuse;
+
+void main()
+{
+    float shade = 0.4 + 0.6 * max(dot(normalize(Normal), normalize(vec3(0.3, 1.0, 0.5))), 0.0);
+    FragColor = vec4(MaterialDiffuse * shade, 1.0);
+}
@@ -10,60 +10,87 @@ struct Material {
 
 struct DirectionalLight {
     vec3 direction;
-    
-    float k_c;  // attenuation factors
-    float k_l;  // attenuation factors
-    float k_q;  // attenuation factors
-    
     vec3 ambient;
     vec3 diffuse;
     vec3 specular;
 };
 
+// point, spot and directional lights live in std140 uniform buffers filled by LightManager (see
+// lightManager.h); the members are ordered so every vec3 shares its 16 byte slot with a float
 struct PointLight {
     vec3 position;
-    
     float k_c;  // attenuation factors
-    float k_l;  // attenuation factors
-    float k_q;  // attenuation factors
-    
     vec3 ambient;
+    float k_l;  // attenuation factors
     vec3 diffuse;
+    float k_q;  // attenuation factors
     vec3 specular;
 };
 
 struct SpotLight {
     vec3 position;
+    float k_c;  // attenuation factors
     vec3 direction;
-
     float cutOff;
-    float outerCutOff;
-    
-    float k_c;  // attenuation factors
-    float k_l;  // attenuation factors
-    float k_q;  // attenuation factors
-    
     vec3 ambient;
+    float k_l;  // attenuation factors
     vec3 diffuse;
+    float k_q;  // attenuation factors
     vec3 specular;
+    float outerCutOff;
 };
 
+#define MAX_POINT_LIGHTS 255
+#define MAX_SPOT_LIGHTS 128
 
+layout (std140) uniform PointLights {
+    int pointLightCount;
+    PointLight pointLights[MAX_POINT_LIGHTS];
+};
 
-#define NR_POINT_LIGHTS 2
+layout (std140) uniform SpotLights {
+    int spotLightCount;
+    SpotLight spotLights[MAX_SPOT_LIGHTS];
+};
+
+layout (std140) uniform DirectionalLightBlock {
+    DirectionalLight directionalLight;
+};
+
+layout (std140) uniform Frame {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+};
 
 in vec3 FragPos;
 in vec3 Normal;
-
-uniform vec3 viewPos;
-uniform PointLight pointLights[NR_POINT_LIGHTS];
-uniform Material material;
-uniform DirectionalLight directionalLight;
-uniform bool directionalLightON = true;
-uniform SpotLight spotLight;
-uniform bool SpotLightON = true;
+// material, per draw or per instance, passed through by the vertex shader
+flat in vec3 MaterialAmbient;
+flat in vec3 MaterialDiffuse;
+flat in vec3 MaterialSpecular;
+flat in float MaterialShininess;
+
+// clustered forward lighting (see lightClusters.h): only the lights reaching this fragment's cluster
+const ivec3 clusterGrid = ivec3(16, 9, 24);     // CLUSTER_X, CLUSTER_Y, CLUSTER_Z
+uniform bool clusteredLighting = false;
+uniform usamplerBuffer clusterTable;            // per cluster: first index, point count | spot count << 16
+uniform usamplerBuffer clusterLightIndices;     // indices into pointLights, then spotLights
+uniform vec2 clusterViewport;
+uniform float clusterDepthScale;                // slice = log(view depth) * scale - bias
+uniform float clusterDepthBias;
+
+// procedural chessboard for the single-slab floor
+uniform bool checkerFloor = false;
+uniform vec2 checkerOrigin;     // world xz of the board corner
+uniform float checkerTileSize;
+uniform int checkerGridSize;
+
+// permutations (see shaderVariants.h): NO_DIRECTIONAL_LIGHT, NO_SPOT_LIGHTS, NO_AMBIENT, NO_DIFFUSE and
+// NO_SPECULAR compile switched-off lights and terms out instead of weighting them with zero
 
 // function prototypes
+vec3 CalcTerms(Material material, vec3 lightAmbient, vec3 lightDiffuse, vec3 lightSpecular, vec3 N, vec3 L, vec3 V);
 vec3 CalcPointLight(Material material, PointLight light, vec3 N, vec3 fragPos, vec3 V);
 vec3 CalcDirectionalLight(Material material, DirectionalLight light, vec3 N, vec3 V);
 vec3 CalcSpotLight(Material material, SpotLight light, vec3 N, vec3 fragPos, vec3 V);
@@ -71,92 +98,107 @@ vec3 CalcSpotLight(Material material, SpotLight light, vec3 N, vec3 fragPos, vec
 void main()
 {
     // properties
+    Material material = Material(MaterialAmbient, MaterialDiffuse, MaterialSpecular, MaterialShininess);
+    if(checkerFloor)
+    {
+        // same pattern as one cube per tile: dark 0.2 when (x + z) is even, light 0.8 otherwise
+        ivec2 tile = ivec2(floor((FragPos.xz - checkerOrigin) / checkerTileSize));
+        tile = clamp(tile, ivec2(0), ivec2(checkerGridSize - 1));
+        float color = ((tile.x + tile.y) % 2 == 0) ? 0.2 : 0.8;
+        material.ambient = vec3(color);
+        material.diffuse = vec3(color);
+    }
     vec3 N = normalize(Normal);
     vec3 V = normalize(viewPos - FragPos);
     
-    vec3 result;
-    // point lights
-    for(int i = 0; i < NR_POINT_LIGHTS; i++){
-        result += CalcPointLight(material, pointLights[i], N, FragPos, V);
-    }
-    // directional light
-    if(directionalLightON){
-        result += CalcDirectionalLight(material, directionalLight, N, V);
+    vec3 result = vec3(0.0);
+    if(clusteredLighting)
+    {
+        float depth = -(view * vec4(FragPos, 1.0)).z;
+        ivec3 cell = ivec3(ivec2(gl_FragCoord.xy / clusterViewport * vec2(clusterGrid.xy)),
+                           int(floor(log(depth) * clusterDepthScale - clusterDepthBias)));
+        cell = clamp(cell, ivec3(0), clusterGrid - 1);
+        uvec2 entry = texelFetch(clusterTable, cell.x + clusterGrid.x * (cell.y + clusterGrid.y * cell.z)).xy;
+        int first = int(entry.x);
+        int points = int(entry.y & 0xFFFFu);
+        int spots = int(entry.y >> 16);
+        for(int i = 0; i < points; i++)
+            result += CalcPointLight(material, pointLights[int(texelFetch(clusterLightIndices, first + i).r)], N, FragPos, V);
+#ifndef NO_SPOT_LIGHTS
+        for(int i = 0; i < spots; i++)
+            result += CalcSpotLight(material, spotLights[int(texelFetch(clusterLightIndices, first + points + i).r)], N, FragPos, V);
+#endif
     }
-    if(SpotLightON)
+    else
     {
-        result += CalcSpotLight(material, spotLight, N, FragPos, V);
+        // point lights
+        for(int i = 0; i < pointLightCount; i++){
+            result += CalcPointLight(material, pointLights[i], N, FragPos, V);
+        }
+        // spot lights
+#ifndef NO_SPOT_LIGHTS
+        for(int i = 0; i < spotLightCount; i++)
+        {
+            result += CalcSpotLight(material, spotLights[i], N, FragPos, V);
+        }
+#endif
     }
+    // directional light
+#ifndef NO_DIRECTIONAL_LIGHT
+    result += CalcDirectionalLight(material, directionalLight, N, V);
+#endif
 
     FragColor = vec4(result, 1.0);
 }
 
+// the Phong terms this permutation keeps, before attenuation
+vec3 CalcTerms(Material material, vec3 lightAmbient, vec3 lightDiffuse, vec3 lightSpecular, vec3 N, vec3 L, vec3 V)
+{
+    vec3 color = vec3(0.0);
+#ifndef NO_AMBIENT
+    color += material.ambient * lightAmbient;
+#endif
+#ifndef NO_DIFFUSE
+    color += material.diffuse * max(dot(N, L), 0.0) * lightDiffuse;
+#endif
+#ifndef NO_SPECULAR
+    vec3 R = reflect(-L, N);
+    color += material.specular * pow(max(dot(V, R), 0.0), material.shininess) * lightSpecular;
+#endif
+    return color;
+}
+
 // calculates the color when using a point light.
 vec3 CalcPointLight(Material material, PointLight light, vec3 N, vec3 fragPos, vec3 V)
 {
     vec3 L = normalize(light.position - fragPos);
-    vec3 R = reflect(-L, N);
-    
-    vec3 K_A = material.ambient;
-    vec3 K_D = material.diffuse;
-    vec3 K_S = material.specular;
     
     // attenuation
     float d = length(light.position - fragPos);
     float attenuation = 1.0 / (light.k_c + light.k_l * d + light.k_q * (d * d));
     
-    vec3 ambient = K_A * light.ambient;
-    vec3 diffuse = K_D * max(dot(N, L), 0.0) * light.diffuse;
-    vec3 specular = K_S * pow(max(dot(V, R), 0.0), material.shininess) * light.specular;
-    
-    ambient *= attenuation;
-    diffuse *= attenuation;
-    specular *= attenuation;
-    
-    return (ambient + diffuse + specular );
+    return CalcTerms(material, light.ambient, light.diffuse, light.specular, N, L, V) * attenuation;
 }
 
 vec3 CalcDirectionalLight(Material material, DirectionalLight light, vec3 N, vec3 V)
 {
     vec3 L = normalize(-light.direction);
-    vec3 R = reflect(-L, N);
-    
-    vec3 K_A = material.ambient;
-    vec3 K_D = material.diffuse;
-    vec3 K_S = material.specular;
-     
-    vec3 ambient = K_A * light.ambient;
-    vec3 diffuse = K_D * max(dot(N, L), 0.0) * light.diffuse;
-    vec3 specular = K_S * pow(max(dot(V, R), 0.0), material.shininess) * light.specular;
     
-    return (ambient + diffuse + specular);
+    return CalcTerms(material, light.ambient, light.diffuse, light.specular, N, L, V);
 }
 
 vec3 CalcSpotLight(Material material, SpotLight light, vec3 N, vec3 fragPos, vec3 V)
 {
     vec3 L = normalize(light.position - fragPos);
-    vec3 R = reflect(-L, N);
-    
-    vec3 K_A = material.ambient;
-    vec3 K_D = material.diffuse;
-    vec3 K_S = material.specular;
     
     // attenuation
     float d = length(light.position - fragPos);
     float attenuation = 1.0 / (light.k_c + light.k_l * d + light.k_q * (d * d));
-    
-    vec3 ambient = K_A * light.ambient;
-    vec3 diffuse = K_D * max(dot(N, L), 0.0) * light.diffuse;
-    vec3 specular = K_S * pow(max(dot(V, R), 0.0), material.shininess) * light.specular;
 
     float cos_alpha = dot(L, normalize(-light.direction));
     float cos_theta = light.cutOff- light.outerCutOff;
 
     float intensity = clamp((cos_alpha-light.outerCutOff)/cos_theta, 0.0, 1.0); 
 
-    ambient *= attenuation * intensity;
-    diffuse *= attenuation * intensity;
-    specular *= attenuation * intensity;
-    
-    return (ambient + diffuse + specular );
+    return CalcTerms(material, light.ambient, light.diffuse, light.specular, N, L, V) * (attenuation * intensity);
 }
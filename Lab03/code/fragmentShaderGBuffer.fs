@@ -0,0 +1,47 @@
+#version 330 core
+// geometry pass of the deferred path (see gBuffer.h): surface attributes only, no lighting
+layout (location = 0) out vec4 gNormal;     // octahedral normal in xy, shininess in z
+layout (location = 1) out vec4 gDiffuse;
+layout (location = 2) out vec4 gAmbient;
+layout (location = 3) out vec4 gSpecular;
+
+in vec3 FragPos;
+in vec3 Normal;
+// material, per draw or per instance, passed through by the vertex shader
+flat in vec3 MaterialAmbient;
+flat in vec3 MaterialDiffuse;
+flat in vec3 MaterialSpecular;
+flat in float MaterialShininess;
+
+// procedural chessboard for the single-slab floor
+uniform bool checkerFloor = false;
+uniform vec2 checkerOrigin;     // world xz of the board corner
+uniform float checkerTileSize;
+uniform int checkerGridSize;
+
+// unit vector folded onto the octahedron and flattened to two components
+vec2 EncodeNormal(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 folded = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return n.z >= 0.0 ? n.xy : folded;
+}
+
+void main()
+{
+    vec3 ambient = MaterialAmbient;
+    vec3 diffuse = MaterialDiffuse;
+    if(checkerFloor)
+    {
+        // same pattern as one cube per tile: dark 0.2 when (x + z) is even, light 0.8 otherwise
+        ivec2 tile = ivec2(floor((FragPos.xz - checkerOrigin) / checkerTileSize));
+        tile = clamp(tile, ivec2(0), ivec2(checkerGridSize - 1));
+        float color = ((tile.x + tile.y) % 2 == 0) ? 0.2 : 0.8;
+        ambient = vec3(color);
+        diffuse = vec3(color);
+    }
+    gNormal = vec4(EncodeNormal(normalize(Normal)), MaterialShininess, 1.0);
+    gDiffuse = vec4(diffuse, 1.0);
+    gAmbient = vec4(ambient, 1.0);
+    gSpecular = vec4(MaterialSpecular, 1.0);
+}
@@ -0,0 +1,82 @@
+//
+//  frameUniforms.h
+//  camera state of the frame in one std140 block read by every program
+//
+
+#ifndef FRAME_UNIFORMS_H
+#define FRAME_UNIFORMS_H
+
+#include <cstring>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "uniformBlocks.h"
+
+// std140 layout of the Frame block: mat4 columns are 16 byte aligned, viewPos shares its slot with padding
+struct FrameData
+{
+    glm::mat4 projection = glm::mat4(1.0f);
+    glm::mat4 view = glm::mat4(1.0f);
+    glm::vec3 viewPos = glm::vec3(0.0f);
+    float padding = 0.0f;
+};
+
+static_assert(sizeof(FrameData) == 144, "FrameData must match the std140 Frame block");
+
+// replaces the projection, view and viewPos uniforms each program used to get separately: set() once per
+// frame writes the whole block with a single buffer update, and none at all while the camera stands still
+class FrameUniforms
+{
+public:
+    static FrameUniforms& current()
+    {
+        static FrameUniforms frame;
+        return frame;
+    }
+
+    // before the first draw of the frame
+    void set(const glm::mat4& projection, const glm::mat4& view, const glm::vec3& viewPos)
+    {
+        if (buffer == 0)
+            buffer = createUniformBuffer(FRAME_BINDING, sizeof(FrameData));
+        FrameData next;
+        next.projection = projection;
+        next.view = view;
+        next.viewPos = viewPos;
+        uploadedBytes = 0;
+        if (uploaded && std::memcmp(&next, &data, sizeof(FrameData)) == 0)
+            return;
+        data = next;
+        updateUniformBuffer(buffer, 0, sizeof(FrameData), &data);
+        uploaded = true;
+        uploadedBytes = sizeof(FrameData);
+    }
+
+    const FrameData& get() const
+    {
+        return data;
+    }
+
+    void release()
+    {
+        if (buffer != 0)
+            glDeleteBuffers(1, &buffer);
+        buffer = 0;
+        uploaded = false;
+    }
+
+    // bytes sent by the last set()
+    unsigned int getUploadedBytes() const
+    {
+        return uploadedBytes;
+    }
+
+private:
+    FrameUniforms() = default;
+
+    FrameData data;
+    GLuint buffer = 0;
+    bool uploaded = false;
+    unsigned int uploadedBytes = 0;
+};
+
+#endif /* FRAME_UNIFORMS_H */
@@ -0,0 +1,148 @@
+//
+//  frustum.h
+//  view frustum planes and bounding volume tests for skipping invisible draws
+//
+
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+class Frustum
+{
+public:
+    // the frustum of the frame being drawn
+    static Frustum& current()
+    {
+        static Frustum frustum;
+        return frustum;
+    }
+
+    // planes of clip space pulled back through projectionView (Gribb/Hartmann); works for any
+    // matrix the vertex shader multiplies positions with, including the off-axis myProjection
+    void update(const glm::mat4& projectionView)
+    {
+        glm::vec4 row[4];
+        for (int i = 0; i < 4; i++)
+            row[i] = glm::vec4(projectionView[0][i], projectionView[1][i], projectionView[2][i], projectionView[3][i]);
+
+        planes[0] = row[3] + row[0];    // left
+        planes[1] = row[3] - row[0];    // right
+        planes[2] = row[3] + row[1];    // bottom
+        planes[3] = row[3] - row[1];    // top
+        planes[4] = row[3] + row[2];    // near
+        planes[5] = row[3] - row[2];    // far
+        for (int i = 0; i < 6; i++)
+            planes[i] /= glm::length(glm::vec3(planes[i]));
+    }
+
+    bool sphereVisible(const glm::vec3& center, float radius) const
+    {
+        for (int i = 0; i < 6; i++)
+            if (glm::dot(glm::vec3(planes[i]), center) + planes[i].w < -radius)
+                return false;
+        return true;
+    }
+
+    // world space AABB: rejected when its most positive corner is behind any plane
+    bool boxVisible(const glm::vec3& minimum, const glm::vec3& maximum) const
+    {
+        for (int i = 0; i < 6; i++)
+        {
+            glm::vec3 normal(planes[i]);
+            glm::vec3 corner(normal.x >= 0.0f ? maximum.x : minimum.x,
+                normal.y >= 0.0f ? maximum.y : minimum.y,
+                normal.z >= 0.0f ? maximum.z : minimum.z);
+            if (glm::dot(normal, corner) + planes[i].w < 0.0f)
+                return false;
+        }
+        return true;
+    }
+
+    enum Containment { OUTSIDE, INTERSECTS, INSIDE };
+
+    // world space AABB against all planes; INSIDE lets hierarchy traversal skip the tests below a node
+    Containment classifyBox(const glm::vec3& minimum, const glm::vec3& maximum) const
+    {
+        if (!enabled)
+            return INSIDE;
+        Containment result = INSIDE;
+        for (int i = 0; i < 6; i++)
+        {
+            glm::vec3 normal(planes[i]);
+            glm::vec3 positive(normal.x >= 0.0f ? maximum.x : minimum.x,
+                normal.y >= 0.0f ? maximum.y : minimum.y,
+                normal.z >= 0.0f ? maximum.z : minimum.z);
+            if (glm::dot(normal, positive) + planes[i].w < 0.0f)
+                return OUTSIDE;
+            glm::vec3 negative(normal.x >= 0.0f ? minimum.x : maximum.x,
+                normal.y >= 0.0f ? minimum.y : maximum.y,
+                normal.z >= 0.0f ? minimum.z : maximum.z);
+            if (glm::dot(normal, negative) + planes[i].w < 0.0f)
+                result = INTERSECTS;
+        }
+        return result;
+    }
+
+    // object space box (boxMin, boxMax) drawn with model: bounding sphere first, then the world AABB
+    // counts the result in the per-frame statistics; always true while culling is disabled
+    bool isVisible(const glm::mat4& model, const glm::vec3& boxMin, const glm::vec3& boxMax)
+    {
+        if (!enabled)
+        {
+            visible++;
+            return true;
+        }
+
+        glm::vec3 localCenter = 0.5f * (boxMin + boxMax);
+        glm::vec3 localExtent = 0.5f * (boxMax - boxMin);
+        glm::vec3 center = glm::vec3(model * glm::vec4(localCenter, 1.0f));
+
+        // world extent of the transformed box (Arvo): |M| * extent
+        glm::mat3 linear(model);
+        glm::vec3 extent(0.0f);
+        for (int column = 0; column < 3; column++)
+            extent += glm::abs(linear[column]) * localExtent[column];
+
+        // the box's own bounding sphere can be tighter than the world AABB once the box is rotated
+        float scale = glm::max(glm::length(linear[0]), glm::max(glm::length(linear[1]), glm::length(linear[2])));
+        float radius = glm::length(localExtent) * scale;
+
+        bool inside = sphereVisible(center, radius) && boxVisible(center - extent, center + extent);
+        if (inside)
+            visible++;
+        else
+            culled++;
+        return inside;
+    }
+
+    // per-frame statistics
+    void resetStats()
+    {
+        visible = 0;
+        culled = 0;
+    }
+    // results of tests done elsewhere, such as a hierarchy traversal
+    void addStats(unsigned int visibleCount, unsigned int culledCount)
+    {
+        visible += visibleCount;
+        culled += culledCount;
+    }
+    unsigned int getVisible() const
+    {
+        return visible;
+    }
+    unsigned int getCulled() const
+    {
+        return culled;
+    }
+
+    bool enabled = true;
+
+private:
+    glm::vec4 planes[6];                // xyz normal pointing inside, w distance
+    unsigned int visible = 0;
+    unsigned int culled = 0;
+};
+
+#endif /* FRUSTUM_H */
@@ -0,0 +1,134 @@
+//
+//  gBuffer.h
+//  render targets of the deferred path: depth plus normal and material per pixel
+//
+
+#ifndef G_BUFFER_H
+#define G_BUFFER_H
+
+#include <iostream>
+#include <glad/glad.h>
+#include "shader.h"
+
+// texture units the lighting pass reads the targets from, after the light cluster textures
+const int GBUFFER_NORMAL_UNIT = 6;
+const int GBUFFER_DIFFUSE_UNIT = 7;
+const int GBUFFER_AMBIENT_UNIT = 8;
+const int GBUFFER_SPECULAR_UNIT = 9;
+const int GBUFFER_DEPTH_UNIT = 10;
+
+// 20 bytes per pixel: RGBA16F octahedral normal + shininess, RGBA8 diffuse, ambient and specular, and
+// a 24-bit depth the lighting pass rebuilds world positions from instead of storing them
+class GBuffer
+{
+public:
+    GBuffer() = default;
+    GBuffer(const GBuffer&) = delete;
+    GBuffer& operator=(const GBuffer&) = delete;
+
+    // (re)creates the targets when the framebuffer size changed
+    void resize(int newWidth, int newHeight)
+    {
+        if (framebuffer != 0 && newWidth == width && newHeight == height)
+            return;
+        release();
+        width = newWidth;
+        height = newHeight;
+
+        glGenFramebuffers(1, &framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        normalTexture = createTarget(GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT, GL_COLOR_ATTACHMENT0);
+        diffuseTexture = createTarget(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, GL_COLOR_ATTACHMENT1);
+        ambientTexture = createTarget(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, GL_COLOR_ATTACHMENT2);
+        specularTexture = createTarget(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, GL_COLOR_ATTACHMENT3);
+        // same format as the default framebuffer's depth, so it can be blitted back
+        depthTexture = createTarget(GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, GL_DEPTH_STENCIL_ATTACHMENT);
+
+        GLenum attachments[4] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3 };
+        glDrawBuffers(4, attachments);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::GBUFFER::FRAMEBUFFER_INCOMPLETE" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    // geometry pass: the scene is drawn into the cleared targets
+    void bindForGeometry()
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    }
+
+    // lighting pass: back to the default framebuffer with every target bound for reading
+    void bindForLighting() const
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        bindTexture(GBUFFER_NORMAL_UNIT, normalTexture);
+        bindTexture(GBUFFER_DIFFUSE_UNIT, diffuseTexture);
+        bindTexture(GBUFFER_AMBIENT_UNIT, ambientTexture);
+        bindTexture(GBUFFER_SPECULAR_UNIT, specularTexture);
+        bindTexture(GBUFFER_DEPTH_UNIT, depthTexture);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // sampler uniforms of the lighting program, which must be in use
+    void setSamplers(const Shader& shader) const
+    {
+        shader.setInt("gNormal", GBUFFER_NORMAL_UNIT);
+        shader.setInt("gDiffuse", GBUFFER_DIFFUSE_UNIT);
+        shader.setInt("gAmbient", GBUFFER_AMBIENT_UNIT);
+        shader.setInt("gSpecular", GBUFFER_SPECULAR_UNIT);
+        shader.setInt("gDepth", GBUFFER_DEPTH_UNIT);
+    }
+
+    // scene depth into the default framebuffer, so objects drawn forward afterwards are still hidden correctly
+    void copyDepthToDefault() const
+    {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+        glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    void release()
+    {
+        if (framebuffer == 0)
+            return;
+        GLuint textures[5] = { normalTexture, diffuseTexture, ambientTexture, specularTexture, depthTexture };
+        glDeleteTextures(5, textures);
+        glDeleteFramebuffers(1, &framebuffer);
+        framebuffer = 0;
+    }
+
+    static int getBytesPerPixel()
+    {
+        return 8 + 4 + 4 + 4 + 4;
+    }
+
+private:
+    GLuint createTarget(GLint internalFormat, GLenum format, GLenum type, GLenum attachment) const
+    {
+        GLuint texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, nullptr);
+        // read with texelFetch only, one texel per pixel
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, texture, 0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        return texture;
+    }
+
+    static void bindTexture(int unit, GLuint texture)
+    {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(GL_TEXTURE_2D, texture);
+    }
+
+    GLuint framebuffer = 0;
+    GLuint normalTexture = 0, diffuseTexture = 0, ambientTexture = 0, specularTexture = 0, depthTexture = 0;
+    int width = 0, height = 0;
+};
+
+#endif /* G_BUFFER_H */
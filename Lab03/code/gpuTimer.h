@@ -0,0 +1,65 @@
+//
+//  gpuTimer.h
+//  GPU time of a span of the frame, read a frame late so the CPU never waits for it
+//
+
+#ifndef GPU_TIMER_H
+#define GPU_TIMER_H
+
+#include <glad/glad.h>
+
+// two GL_TIME_ELAPSED queries used in turns, like OcclusionQueryState: this frame's span is timed while
+// last frame's result is collected
+class GpuTimer
+{
+public:
+    void begin()
+    {
+        if (queries[0] == 0)
+            glGenQueries(2, queries);
+        glBeginQuery(GL_TIME_ELAPSED, queries[current]);
+    }
+
+    void end()
+    {
+        glEndQuery(GL_TIME_ELAPSED);
+        issued[current] = true;
+        current = 1 - current;
+
+        // the other query was issued last frame; take its result only if it is already there
+        if (issued[current])
+        {
+            GLint available = 0;
+            glGetQueryObjectiv(queries[current], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available)
+            {
+                GLuint64 nanoseconds = 0;
+                glGetQueryObjectui64v(queries[current], GL_QUERY_RESULT, &nanoseconds);
+                milliseconds = nanoseconds / 1.0e6;
+                issued[current] = false;
+            }
+        }
+    }
+
+    void release()
+    {
+        if (queries[0] != 0)
+            glDeleteQueries(2, queries);
+        queries[0] = queries[1] = 0;
+        issued[0] = issued[1] = false;
+    }
+
+    // most recent completed measurement
+    double getMilliseconds() const
+    {
+        return milliseconds;
+    }
+
+private:
+    unsigned int queries[2] = { 0, 0 };
+    bool issued[2] = { false, false };
+    int current = 0;
+    double milliseconds = 0.0;
+};
+
+#endif /* GPU_TIMER_H */
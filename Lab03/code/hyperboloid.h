@@ -1,10 +1,12 @@
 #ifndef HYPERBOLOID_H
 #define HYPERBOLOID_H
 
+#include <algorithm>
 #include <vector>
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 #include "shader.h"
+#include "meshCache.h"
 
 #define PI 3.1416
 
@@ -17,34 +19,41 @@ public:
     // Constructor
     Hyperboloid(float a = 1.0f, float b = 1.0f, float c = 1.0f, int uSegments = 50, int vSegments = 50)
         : a(a), b(b), c(c), uSegments(uSegments), vSegments(vSegments) {
-        generateVertices();
-        generateIndices();
-        setupBuffers();
+        // One tessellation per LOD level, each shared with every hyperboloid of the same a/b/c and segment counts
+        for (int level = 0; level < MAX_LOD_LEVELS; level++) {
+            int us = std::max(uSegments >> level, 3);
+            int vs = std::max(vSegments >> level, 2);
+            lods[level] = MeshCache::instance().acquire(MeshKey(SHAPE_HYPERBOLOID, a, b, c, us, vs),
+                [this, us, vs](std::vector<float>& vertices, std::vector<unsigned int>& indices) {
+                    generateVertices(us, vs, vertices);
+                    generateIndices(us, vs, indices);
+                });
+        }
     }
 
-    // Destructor
-    ~Hyperboloid() {
-        glDeleteVertexArrays(1, &VAO);
-        glDeleteBuffers(1, &VBO);
-        glDeleteBuffers(1, &EBO);
-    }
+    // Destructor (the mesh cache releases the shared mesh)
+    ~Hyperboloid() {}
+
+    // Location of the full detail mesh in the arena, for multi-draw lists
+    const MeshRange& getMeshRange() const { return lods[0]->range; }
 
-    void drawHyperboloid(Shader& shader, glm::mat4 model) const {
+    // Full detail mesh, for its object space bounds
+    const ParametricMesh& getMesh() const { return *lods[0]; }
+
+    void drawHyperboloid(Shader& shader, glm::mat4 model, LodState* lod = nullptr) const {
+        if (!meshVisible(*lods[0], model))
+            return;
         shader.use();
-        shader.setMat4("model", model);
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
+        shader.setModel(Affine(model));
+        selectLod(lods, model, lod).draw(shader);
     }
 
 private:
     float a, b, c;
     int uSegments, vSegments;
-    std::vector<float> vertices;
-    std::vector<unsigned int> indices;
-    unsigned int VAO, VBO, EBO;
+    std::shared_ptr<const ParametricMesh> lods[MAX_LOD_LEVELS];  // Shared geometry, finest first, see meshCache.h
 
-    void generateVertices() {
+    void generateVertices(int uSegments, int vSegments, std::vector<float>& vertices) {
         for (int i = 0; i <= vSegments; ++i) {
             float v = -2.0f + i * (4.0f / vSegments);
             for (int j = 0; j <= uSegments; ++j) {
@@ -73,7 +82,7 @@ private:
     }
 
 
-    void generateIndices() {
+    void generateIndices(int uSegments, int vSegments, std::vector<unsigned int>& indices) {
         for (int i = 0; i < vSegments; ++i) {
             for (int j = 0; j < uSegments; ++j) {
                 int p1 = i * (uSegments + 1) + j;
@@ -89,30 +98,6 @@ private:
             }
         }
     }
-
-    void setupBuffers() {
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
-        glGenBuffers(1, &EBO);
-
-        glBindVertexArray(VAO);
-
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
-
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
-
-        // Vertex positions
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-
-        // Normals
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
-
-        glBindVertexArray(0);
-    }
 };
 
 #endif /* HYPERBOLOID_H */
\ No newline at end of file
@@ -0,0 +1,441 @@
+//
+//  lightClusters.h
+//  clustered forward lighting: per view space cluster light lists built on the CPU, read through texture buffers
+//
+
+#ifndef LIGHT_CLUSTERS_H
+#define LIGHT_CLUSTERS_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "shader.h"
+#include "lightManager.h"
+#include "transformStore.h"
+
+// screen tiles across, down and exponential depth slices between the near and far planes
+const int CLUSTER_X = 16;
+const int CLUSTER_Y = 9;
+const int CLUSTER_Z = 24;
+const int CLUSTER_COUNT = CLUSTER_X * CLUSTER_Y * CLUSTER_Z;
+
+// texture units of the two buffer textures, above the low units material textures would take
+const int CLUSTER_TABLE_UNIT = 4;
+const int CLUSTER_INDEX_UNIT = 5;
+
+// a light stops at the distance where its attenuated color falls below one 8-bit step
+const float LIGHT_CUTOFF = 1.0f / 256.0f;
+
+// builds, every frame, the lights whose range reaches each cluster: one table texel per cluster
+// (first list entry, point count | spot count << 16) and one list of light indices into the LightManager
+// blocks. Clusters are tested against a light several at a time, and depth slices are shared out
+// between worker threads, each writing only its own clusters' lists
+class LightClusters
+{
+public:
+    static LightClusters& current()
+    {
+        static LightClusters clusters;
+        return clusters;
+    }
+
+    // distance at which 1 / (k_c + k_l d + k_q d^2) times the brightest channel reaches LIGHT_CUTOFF
+    static float attenuationRadius(float k_c, float k_l, float k_q, const glm::vec3& color)
+    {
+        float brightest = std::max(color.r, std::max(color.g, color.b));
+        if (brightest <= 0.0f)
+            return 0.0f;
+        float limit = brightest / LIGHT_CUTOFF - k_c;     // k_l d + k_q d^2 must reach this
+        if (limit <= 0.0f)
+            return 0.0f;
+        if (k_q > 0.0f)
+            return (-k_l + std::sqrt(k_l * k_l + 4.0f * k_q * limit)) / (2.0f * k_q);
+        if (k_l > 0.0f)
+            return limit / k_l;
+        return 1e30f;   // no falloff: reaches every cluster
+    }
+
+    // assigns the packed lights of the LightManager to the clusters of this camera and uploads the lists
+    void build(const glm::mat4& view, const glm::mat4& projection, int viewportWidth, int viewportHeight, const LightManager& lights)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        viewport = glm::vec2((float)viewportWidth, (float)viewportHeight);
+        if (projection != clusterProjection)
+            buildClusterBounds(projection);
+
+        // view space spheres and the depth slices they reach, shared by every worker
+        gatherLights(view, lights.getPackedPointLights(), pointSpheres);
+        gatherLights(view, lights.getPackedSpotLights(), spotSpheres);
+
+        runWorkers([this](int worker, int workerCount)
+        {
+            int firstSlice = CLUSTER_Z * worker / workerCount;
+            int endSlice = CLUSTER_Z * (worker + 1) / workerCount;
+            assignLights(pointSpheres, firstSlice, endSlice, pointLists);
+            assignLights(spotSpheres, firstSlice, endSlice, spotLists);
+        });
+
+        // flatten in cluster order, the way the shader walks them
+        table.resize(CLUSTER_COUNT * 2);
+        indices.clear();
+        pairs = 0;
+        maxPerCluster = 0;
+        overflow = false;
+        for (int cluster = 0; cluster < CLUSTER_COUNT; cluster++)
+        {
+            const std::vector<unsigned short>& points = pointLists[cluster];
+            const std::vector<unsigned short>& spots = spotLists[cluster];
+            size_t count = points.size() + spots.size();
+            if (indices.size() + count > maxIndices)
+            {
+                // past what one buffer texture can address: leave the remaining clusters unlit
+                overflow = true;
+                table[cluster * 2] = (unsigned int)indices.size();
+                table[cluster * 2 + 1] = 0;
+                continue;
+            }
+            table[cluster * 2] = (unsigned int)indices.size();
+            table[cluster * 2 + 1] = (unsigned int)points.size() | ((unsigned int)spots.size() << 16);
+            indices.insert(indices.end(), points.begin(), points.end());
+            indices.insert(indices.end(), spots.begin(), spots.end());
+            pairs += (unsigned int)count;
+            maxPerCluster = std::max(maxPerCluster, (unsigned int)count);
+        }
+        upload();
+        buildTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+    // cluster uniforms of one program, which must be in use; with enabled off the shader loops over every light
+    void bind(const Shader& shader) const
+    {
+        shader.setBool("clusteredLighting", enabled && tableTexture != 0);
+        shader.setInt("clusterTable", CLUSTER_TABLE_UNIT);
+        shader.setInt("clusterLightIndices", CLUSTER_INDEX_UNIT);
+        shader.setVec2("clusterViewport", viewport);
+        shader.setFloat("clusterDepthScale", depthScale);
+        shader.setFloat("clusterDepthBias", depthBias);
+    }
+
+    void release()
+    {
+        if (tableTexture != 0)
+        {
+            glDeleteTextures(1, &tableTexture);
+            glDeleteTextures(1, &indexTexture);
+            glDeleteBuffers(1, &tableBuffer);
+            glDeleteBuffers(1, &indexBuffer);
+        }
+        tableTexture = indexTexture = tableBuffer = indexBuffer = 0;
+    }
+
+    // statistics of the last build: light/cluster pairs, the longest list and the CPU time it took
+    unsigned int getPairs() const
+    {
+        return pairs;
+    }
+    unsigned int getMaxPerCluster() const
+    {
+        return maxPerCluster;
+    }
+    double getBuildTime() const
+    {
+        return buildTime;
+    }
+    int getThreadCount() const
+    {
+        return threadCount;
+    }
+    bool getOverflow() const
+    {
+        return overflow;
+    }
+
+    bool enabled = true;
+
+private:
+    struct LightSphere
+    {
+        glm::vec3 center;       // view space
+        float radius;
+        int firstSlice, lastSlice;
+    };
+
+    LightClusters()
+    {
+        pointLists.resize(CLUSTER_COUNT);
+        spotLists.resize(CLUSTER_COUNT);
+        for (int axis = 0; axis < 3; axis++)
+        {
+            boundsMin[axis].resize(CLUSTER_COUNT);
+            boundsMax[axis].resize(CLUSTER_COUNT);
+        }
+        // the main thread takes a share as well; four threads are plenty for a few thousand clusters
+        unsigned int hardware = std::thread::hardware_concurrency();
+        threadCount = (int)std::min(hardware > 0 ? hardware : 1u, 4u);
+        for (int i = 1; i < threadCount; i++)
+            workers.push_back(std::thread(&LightClusters::workerLoop, this, i));
+    }
+    ~LightClusters()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            quitting = true;
+        }
+        wake.notify_all();
+        for (size_t i = 0; i < workers.size(); i++)
+            workers[i].join();
+    }
+    LightClusters(const LightClusters&) = delete;
+    LightClusters& operator=(const LightClusters&) = delete;
+
+    // view space box of every cluster, redone only when the projection changes
+    void buildClusterBounds(const glm::mat4& projection)
+    {
+        clusterProjection = projection;
+        nearPlane = projection[3][2] / (projection[2][2] - 1.0f);
+        farPlane = projection[3][2] / (projection[2][2] + 1.0f);
+        float logRatio = std::log(farPlane / nearPlane);
+        depthScale = CLUSTER_Z / logRatio;
+        depthBias = CLUSTER_Z * std::log(nearPlane) / logRatio;
+
+        // rays through the tile corners, as points on the near plane
+        glm::mat4 inverseProjection = glm::inverse(projection);
+        std::vector<glm::vec3> corners((CLUSTER_X + 1) * (CLUSTER_Y + 1));
+        for (int y = 0; y <= CLUSTER_Y; y++)
+            for (int x = 0; x <= CLUSTER_X; x++)
+            {
+                glm::vec4 ndc(-1.0f + 2.0f * x / CLUSTER_X, -1.0f + 2.0f * y / CLUSTER_Y, -1.0f, 1.0f);
+                glm::vec4 point = inverseProjection * ndc;
+                corners[y * (CLUSTER_X + 1) + x] = glm::vec3(point) / point.w;
+            }
+
+        for (int z = 0; z < CLUSTER_Z; z++)
+        {
+            float sliceNear = sliceDepth(z), sliceFar = sliceDepth(z + 1);
+            for (int y = 0; y < CLUSTER_Y; y++)
+                for (int x = 0; x < CLUSTER_X; x++)
+                {
+                    glm::vec3 low(1e30f), high(-1e30f);
+                    for (int corner = 0; corner < 4; corner++)
+                    {
+                        glm::vec3 ray = corners[(y + corner / 2) * (CLUSTER_X + 1) + x + corner % 2];
+                        glm::vec3 a = ray * (sliceNear / nearPlane), b = ray * (sliceFar / nearPlane);
+                        low = glm::min(low, glm::min(a, b));
+                        high = glm::max(high, glm::max(a, b));
+                    }
+                    int cluster = clusterIndex(x, y, z);
+                    for (int axis = 0; axis < 3; axis++)
+                    {
+                        boundsMin[axis][cluster] = low[axis];
+                        boundsMax[axis][cluster] = high[axis];
+                    }
+                }
+        }
+    }
+
+    float sliceDepth(int slice) const
+    {
+        return nearPlane * std::pow(farPlane / nearPlane, (float)slice / CLUSTER_Z);
+    }
+    int sliceOf(float depth) const
+    {
+        int slice = (int)std::floor(std::log(depth) * depthScale - depthBias);
+        return std::min(std::max(slice, 0), CLUSTER_Z - 1);
+    }
+    static int clusterIndex(int x, int y, int z)
+    {
+        return x + CLUSTER_X * (y + CLUSTER_Y * z);
+    }
+
+    template <typename Light>
+    void gatherLights(const glm::mat4& view, const std::vector<Light>& lights, std::vector<LightSphere>& spheres) const
+    {
+        spheres.clear();
+        for (size_t i = 0; i < lights.size(); i++)
+        {
+            const Light& light = lights[i];
+            LightSphere sphere;
+            sphere.center = glm::vec3(view * glm::vec4(light.position, 1.0f));
+            sphere.radius = attenuationRadius(light.k_c, light.k_l, light.k_q, light.ambient + light.diffuse + light.specular);
+            float closest = -sphere.center.z - sphere.radius, farthest = -sphere.center.z + sphere.radius;
+            if (sphere.radius <= 0.0f || farthest < nearPlane || closest > farPlane)
+            {
+                sphere.firstSlice = 1;      // lights nothing this frame
+                sphere.lastSlice = 0;
+            }
+            else
+            {
+                sphere.firstSlice = sliceOf(std::max(closest, nearPlane));
+                sphere.lastSlice = sliceOf(std::min(farthest, farPlane));
+            }
+            spheres.push_back(sphere);
+        }
+    }
+
+    // sphere against cluster boxes, TransformLanes::WIDTH clusters per step, for the slices [firstSlice, endSlice)
+    void assignLights(const std::vector<LightSphere>& spheres, int firstSlice, int endSlice, std::vector<std::vector<unsigned short>>& lists) const
+    {
+        typedef TransformLanes L;
+        const int width = L::WIDTH;
+        const int perSlice = CLUSTER_X * CLUSTER_Y;
+        for (int cluster = firstSlice * perSlice; cluster < endSlice * perSlice; cluster++)
+            lists[cluster].clear();
+
+        for (size_t light = 0; light < spheres.size(); light++)
+        {
+            const LightSphere& sphere = spheres[light];
+            int begin = std::max(sphere.firstSlice, firstSlice) * perSlice;
+            int end = (std::min(sphere.lastSlice, endSlice - 1) + 1) * perSlice;
+            if (begin >= end)
+                continue;
+            L::Type center[3] = { L::set(sphere.center.x), L::set(sphere.center.y), L::set(sphere.center.z) };
+            L::Type radiusSquared = L::set(sphere.radius * sphere.radius);
+            L::Type zero = L::zero();
+            int cluster = begin;
+            for (; cluster + width <= end; cluster += width)
+            {
+                // squared distance from the center to the box: the per axis overshoot past either face
+                L::Type distance = zero;
+                for (int axis = 0; axis < 3; axis++)
+                {
+                    L::Type below = L::max(L::sub(L::load(&boundsMin[axis][cluster]), center[axis]), zero);
+                    L::Type above = L::max(L::sub(center[axis], L::load(&boundsMax[axis][cluster])), zero);
+                    L::Type outside = L::add(below, above);
+                    distance = L::add(distance, L::mul(outside, outside));
+                }
+                int hits = L::lessEqual(distance, radiusSquared);
+                for (int lane = 0; hits != 0; lane++, hits >>= 1)
+                    if (hits & 1)
+                        lists[cluster + lane].push_back((unsigned short)light);
+            }
+            for (; cluster < end; cluster++)
+            {
+                float distance = 0.0f;
+                for (int axis = 0; axis < 3; axis++)
+                {
+                    float outside = std::max(boundsMin[axis][cluster] - sphere.center[axis], 0.0f) +
+                        std::max(sphere.center[axis] - boundsMax[axis][cluster], 0.0f);
+                    distance += outside * outside;
+                }
+                if (distance <= sphere.radius * sphere.radius)
+                    lists[cluster].push_back((unsigned short)light);
+            }
+        }
+    }
+
+    // runs work(worker, threadCount) on every worker and on this thread, and returns when all are done
+    void runWorkers(const std::function<void(int, int)>& work)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = work;
+            pending = threadCount - 1;
+            generation++;
+        }
+        wake.notify_all();
+        work(0, threadCount);
+        std::unique_lock<std::mutex> lock(mutex);
+        finished.wait(lock, [this] { return pending == 0; });
+    }
+
+    void workerLoop(int worker)
+    {
+        unsigned int seen = 0;
+        while (true)
+        {
+            std::function<void(int, int)> work;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this, seen] { return quitting || generation != seen; });
+                if (quitting)
+                    return;
+                seen = generation;
+                work = job;
+            }
+            work(worker, threadCount);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                pending--;
+            }
+            finished.notify_one();
+        }
+    }
+
+    // table as RG32UI texels and the index list as R16UI, both re-specified every frame
+    void upload()
+    {
+        if (tableTexture == 0)
+        {
+            GLint limit = 0;
+            glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &limit);
+            maxIndices = (size_t)limit;
+            glGenBuffers(1, &tableBuffer);
+            glGenBuffers(1, &indexBuffer);
+            glGenTextures(1, &tableTexture);
+            glGenTextures(1, &indexTexture);
+        }
+
+        glBindBuffer(GL_TEXTURE_BUFFER, tableBuffer);
+        glBufferData(GL_TEXTURE_BUFFER, table.size() * sizeof(unsigned int), table.data(), GL_STREAM_DRAW);
+        glBindBuffer(GL_TEXTURE_BUFFER, indexBuffer);
+        // never empty, so the texture always has storage behind it
+        if (indices.empty())
+            indices.push_back(0);
+        glBufferData(GL_TEXTURE_BUFFER, indices.size() * sizeof(unsigned short), indices.data(), GL_STREAM_DRAW);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+        glActiveTexture(GL_TEXTURE0 + CLUSTER_TABLE_UNIT);
+        glBindTexture(GL_TEXTURE_BUFFER, tableTexture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32UI, tableBuffer);
+        glActiveTexture(GL_TEXTURE0 + CLUSTER_INDEX_UNIT);
+        glBindTexture(GL_TEXTURE_BUFFER, indexTexture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_R16UI, indexBuffer);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // cluster geometry
+    glm::mat4 clusterProjection = glm::mat4(0.0f);
+    float nearPlane = 0.1f, farPlane = 100.0f;
+    float depthScale = 0.0f, depthBias = 0.0f;
+    glm::vec2 viewport = glm::vec2(1.0f);
+    std::vector<float> boundsMin[3];    // per axis, one entry per cluster
+    std::vector<float> boundsMax[3];
+
+    // this frame's lights and lists
+    std::vector<LightSphere> pointSpheres;
+    std::vector<LightSphere> spotSpheres;
+    std::vector<std::vector<unsigned short>> pointLists;
+    std::vector<std::vector<unsigned short>> spotLists;
+    std::vector<unsigned int> table;
+    std::vector<unsigned short> indices;
+    size_t maxIndices = 65536;
+
+    // GL objects
+    GLuint tableBuffer = 0, indexBuffer = 0;
+    GLuint tableTexture = 0, indexTexture = 0;
+
+    // worker threads
+    int threadCount = 1;                // workers plus the calling thread
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable finished;
+    std::function<void(int, int)> job;
+    unsigned int generation = 0;
+    int pending = 0;
+    bool quitting = false;
+
+    unsigned int pairs = 0;
+    unsigned int maxPerCluster = 0;
+    double buildTime = 0.0;
+    bool overflow = false;
+};
+
+#endif /* LIGHT_CLUSTERS_H */
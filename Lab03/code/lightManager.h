@@ -0,0 +1,276 @@
+//
+//  lightManager.h
+//  point, spot and directional lights, packed into std140 uniform buffers and uploaded only when changed
+//
+
+#ifndef LIGHT_MANAGER_H
+#define LIGHT_MANAGER_H
+
+#include <cstring>
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "uniformBlocks.h"
+
+// array sizes of the PointLights and SpotLights blocks in the lit shaders; each block stays below
+// the 16 KB GL 3.3 guarantees for one uniform block
+const int MAX_POINT_LIGHTS = 255;
+const int MAX_SPOT_LIGHTS = 128;
+
+// std140 element of the PointLights block: each vec3 shares its 16 byte slot with a float
+struct PointLightData
+{
+    glm::vec3 position = glm::vec3(0.0f);
+    float k_c = 1.0f;
+    glm::vec3 ambient = glm::vec3(0.0f);
+    float k_l = 0.0f;
+    glm::vec3 diffuse = glm::vec3(0.0f);
+    float k_q = 0.0f;
+    glm::vec3 specular = glm::vec3(0.0f);
+    float padding = 0.0f;
+};
+
+// std140 element of the SpotLights block; cutOff and outerCutOff are cosines of the cone angles
+struct SpotLightData
+{
+    glm::vec3 position = glm::vec3(0.0f);
+    float k_c = 1.0f;
+    glm::vec3 direction = glm::vec3(0.0f, -1.0f, 0.0f);
+    float cutOff = 1.0f;
+    glm::vec3 ambient = glm::vec3(0.0f);
+    float k_l = 0.0f;
+    glm::vec3 diffuse = glm::vec3(0.0f);
+    float k_q = 0.0f;
+    glm::vec3 specular = glm::vec3(0.0f);
+    float outerCutOff = 1.0f;
+};
+
+// std140 layout of the DirectionalLightBlock
+struct DirectionalLightData
+{
+    glm::vec3 direction = glm::vec3(0.0f, -1.0f, 0.0f);
+    float padding0 = 0.0f;
+    glm::vec3 ambient = glm::vec3(0.0f);
+    float padding1 = 0.0f;
+    glm::vec3 diffuse = glm::vec3(0.0f);
+    float padding2 = 0.0f;
+    glm::vec3 specular = glm::vec3(0.0f);
+    float padding3 = 0.0f;
+};
+
+static_assert(sizeof(PointLightData) == 64, "PointLightData must match the std140 PointLight struct");
+static_assert(sizeof(SpotLightData) == 80, "SpotLightData must match the std140 SpotLight struct");
+static_assert(sizeof(DirectionalLightData) == 64, "DirectionalLightData must match the std140 DirectionalLight struct");
+
+class LightManager
+{
+public:
+    static LightManager& current()
+    {
+        static LightManager manager;
+        return manager;
+    }
+
+    // lights keep their index for life; disabled ones are left out of the buffer
+    int addPointLight(const PointLightData& light)
+    {
+        pointLights.push_back(light);
+        pointEnabled.push_back(true);
+        pointDirty = true;
+        return (int)pointLights.size() - 1;
+    }
+    int addSpotLight(const SpotLightData& light)
+    {
+        spotLights.push_back(light);
+        spotEnabled.push_back(true);
+        spotDirty = true;
+        return (int)spotLights.size() - 1;
+    }
+
+    // the setters only mark the buffer for upload when something really changed
+    void setPointLight(int index, const PointLightData& light)
+    {
+        if (std::memcmp(&pointLights[index], &light, sizeof(PointLightData)) != 0)
+        {
+            pointLights[index] = light;
+            pointDirty = true;
+        }
+    }
+    void setSpotLight(int index, const SpotLightData& light)
+    {
+        if (std::memcmp(&spotLights[index], &light, sizeof(SpotLightData)) != 0)
+        {
+            spotLights[index] = light;
+            spotDirty = true;
+        }
+    }
+    void setDirectionalLight(const DirectionalLightData& light)
+    {
+        if (std::memcmp(&directionalLight, &light, sizeof(DirectionalLightData)) != 0)
+        {
+            directionalLight = light;
+            directionalDirty = true;
+        }
+    }
+    void setPointLightEnabled(int index, bool enabled)
+    {
+        if (pointEnabled[index] != enabled)
+        {
+            pointEnabled[index] = enabled;
+            pointDirty = true;
+        }
+    }
+    void setSpotLightEnabled(int index, bool enabled)
+    {
+        if (spotEnabled[index] != enabled)
+        {
+            spotEnabled[index] = enabled;
+            spotDirty = true;
+        }
+    }
+    const PointLightData& getPointLight(int index) const
+    {
+        return pointLights[index];
+    }
+    const SpotLightData& getSpotLight(int index) const
+    {
+        return spotLights[index];
+    }
+
+    // the lights as the shaders index them, valid after upload(); light lists refer to these indices
+    const std::vector<PointLightData>& getPackedPointLights() const
+    {
+        return packedPointLights;
+    }
+    const std::vector<SpotLightData>& getPackedSpotLights() const
+    {
+        return packedSpotLights;
+    }
+
+    // packs and uploads the blocks whose lights changed since the last call; once per frame before drawing
+    void upload()
+    {
+        uploadedBytes = 0;
+        if (pointBuffer == 0)
+        {
+            pointBuffer = createUniformBuffer(POINT_LIGHT_BINDING, HEADER_BYTES + MAX_POINT_LIGHTS * sizeof(PointLightData));
+            spotBuffer = createUniformBuffer(SPOT_LIGHT_BINDING, HEADER_BYTES + MAX_SPOT_LIGHTS * sizeof(SpotLightData));
+            directionalBuffer = createUniformBuffer(DIRECTIONAL_LIGHT_BINDING, sizeof(DirectionalLightData));
+        }
+        if (pointDirty)
+        {
+            pointCount = pack(pointLights, pointEnabled, MAX_POINT_LIGHTS, packedPointLights, staging, pointDropped);
+            uploadedBytes += update(pointBuffer, staging);
+            pointDirty = false;
+        }
+        if (spotDirty)
+        {
+            spotCount = pack(spotLights, spotEnabled, MAX_SPOT_LIGHTS, packedSpotLights, staging, spotDropped);
+            uploadedBytes += update(spotBuffer, staging);
+            spotDirty = false;
+        }
+        if (directionalDirty)
+        {
+            updateUniformBuffer(directionalBuffer, 0, sizeof(DirectionalLightData), &directionalLight);
+            uploadedBytes += sizeof(DirectionalLightData);
+            directionalDirty = false;
+        }
+    }
+
+    void release()
+    {
+        if (pointBuffer != 0)
+        {
+            glDeleteBuffers(1, &pointBuffer);
+            glDeleteBuffers(1, &spotBuffer);
+            glDeleteBuffers(1, &directionalBuffer);
+        }
+        pointBuffer = 0;
+        spotBuffer = 0;
+        directionalBuffer = 0;
+        pointDirty = spotDirty = directionalDirty = true;
+    }
+
+    // lights in the buffers (enabled, up to the block sizes) and bytes sent by the last upload()
+    int getPointLightCount() const
+    {
+        return pointCount;
+    }
+    int getSpotLightCount() const
+    {
+        return spotCount;
+    }
+    unsigned int getUploadedBytes() const
+    {
+        return uploadedBytes;
+    }
+    // enabled lights past the block sizes, left out of the buffers and so never drawn
+    int getDroppedPointLights() const
+    {
+        return pointDropped;
+    }
+    int getDroppedSpotLights() const
+    {
+        return spotDropped;
+    }
+
+private:
+    // the int count leads each block and its array starts at the next 16 byte boundary
+    static const int HEADER_BYTES = 16;
+
+    LightManager() = default;
+
+    // the enabled lights in shader order, then the count header followed by them as the block lays them out;
+    // dropped counts the enabled lights that did not fit
+    template <typename Light>
+    static int pack(const std::vector<Light>& lights, const std::vector<bool>& enabled, int maxLights,
+        std::vector<Light>& packed, std::vector<unsigned char>& out, int& dropped)
+    {
+        packed.clear();
+        dropped = 0;
+        for (size_t i = 0; i < lights.size(); i++)
+        {
+            if (!enabled[i])
+                continue;
+            if ((int)packed.size() < maxLights)
+                packed.push_back(lights[i]);
+            else
+                dropped++;
+        }
+        int count = (int)packed.size();
+        out.assign(HEADER_BYTES, 0);
+        std::memcpy(out.data(), &count, sizeof(int));
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(packed.data());
+        out.insert(out.end(), bytes, bytes + count * sizeof(Light));
+        return count;
+    }
+
+    // only the used part of the block goes over the bus; the shader never reads past the count
+    static unsigned int update(GLuint buffer, const std::vector<unsigned char>& data)
+    {
+        updateUniformBuffer(buffer, 0, data.size(), data.data());
+        return (unsigned int)data.size();
+    }
+
+    std::vector<PointLightData> pointLights;
+    std::vector<bool> pointEnabled;
+    std::vector<SpotLightData> spotLights;
+    std::vector<bool> spotEnabled;
+    std::vector<PointLightData> packedPointLights;     // what the buffers hold, in shader index order
+    std::vector<SpotLightData> packedSpotLights;
+    DirectionalLightData directionalLight;
+    std::vector<unsigned char> staging;
+    GLuint pointBuffer = 0;
+    GLuint spotBuffer = 0;
+    GLuint directionalBuffer = 0;
+    bool pointDirty = true;
+    bool spotDirty = true;
+    bool directionalDirty = true;
+    int pointCount = 0;
+    int spotCount = 0;
+    int pointDropped = 0;
+    int spotDropped = 0;
+    unsigned int uploadedBytes = 0;
+};
+
+#endif /* LIGHT_MANAGER_H */
@@ -6,13 +6,27 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include "shader.h"
+#include "shaderVariants.h"
 #include "camera.h"
 #include "basic_camera.h"
 #include "pointLight.h"
+#include "lightManager.h"
+#include "frameUniforms.h"
+#include "materialTable.h"
+#include "lightClusters.h"
+#include "gBuffer.h"
+#include "gpuTimer.h"
+#include "depthPrepass.h"
 #include "sphere.h"
 #include "cone.h"
 #include "cylinder.h"
 #include "hyperboloid.h"
+#include "boxBatch.h"
+#include "frustum.h"
+#include "bvh.h"
+#include "occlusionCuller.h"
+#include "occlusionQuery.h"
+#include "transformStore.h"
 
 
 #include <iostream>
@@ -25,6 +39,7 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void processInput(GLFWwindow* window);
 void drawCube(unsigned int& cubeVAO, Shader& lightingShader, glm::mat4 model, float r, float g, float b, float shininess);
+void drawCubeImmediate(unsigned int& cubeVAO, Shader& lightingShader, glm::mat4 model, float r, float g, float b, float shininess);
 void drawFloor(unsigned int& cubeVAO, Shader& lightingShader);
 void drawLights(unsigned int& cubeVAO, Shader& lightingShader);
 void drawKitchen(unsigned int& cubeVAO, Shader& lightingShader);
@@ -32,9 +47,18 @@ void leftWall(unsigned int& cubeVAO, Shader& lightingShader);
 void frontWall(unsigned int& cubeVAO, Shader& lightingShader);
 void rightWall(unsigned int& cubeVAO, Shader& lightingShader);
 void drawWalls(unsigned int& cubeVAO, Shader& lightingShader);
-void ambienton_off(Shader& lightingShader);
-void diffuse_on_off(Shader& lightingShader);
-void specular_on_off(Shader& lightingShader);
+glm::mat4 leftShelvesModel();
+glm::mat4 frontShelvesModel();
+glm::mat4 leftWallModel();
+glm::mat4 rightWallModel();
+glm::mat4 frontWallModel();
+void addKitchenOccluders(OcclusionCuller& culler);
+void ambienton_off();
+void diffuse_on_off();
+void specular_on_off();
+unsigned int lightingPermutation();
+void setUpLighting(Shader& lightingShader);
+void updateLights(LightManager& lights);
 
 glm::mat4 myPerspective(float fov, float aspect, float near, float far) {
     glm::mat4 result(0.0f); // Initialize to a zero matrix
@@ -143,6 +167,10 @@ bool pointLightOn1 = true;
 bool pointLightOn2 = true;
 bool directionalLightOn = true;
 bool SpotLightOn = true;
+int spotLightSlot = -1;     // the spot light's index in the LightManager
+// extra small point lights spread over the floor to load the lighting path, cycled 0/100/250 with F2
+int stressLightCount = 0;
+std::vector<int> stressLights;
 bool AmbientON = true;
 bool DiffusionON = true;
 bool SpecularON = true;
@@ -150,6 +178,43 @@ bool ambientToggle = true;
 bool diffuseToggle = true;
 bool specularToggle = true;
 
+// lit program permutations (see shaderVariants.h): one bit per light or term that is switched off,
+// in the order of LIGHTING_DEFINES
+enum LightingFeature
+{
+    LIGHTING_NO_DIRECTIONAL = 1 << 0,
+    LIGHTING_NO_SPOT = 1 << 1,
+    LIGHTING_NO_AMBIENT = 1 << 2,
+    LIGHTING_NO_DIFFUSE = 1 << 3,
+    LIGHTING_NO_SPECULAR = 1 << 4
+};
+const std::vector<std::string> LIGHTING_DEFINES = { "NO_DIRECTIONAL_LIGHT", "NO_SPOT_LIGHTS", "NO_AMBIENT", "NO_DIFFUSE", "NO_SPECULAR" };
+
+// instanced box rendering: drawCube records into the batch, one draw per frame (toggle with I)
+BoxBatch* boxBatch = nullptr;
+bool useBoxBatch = true;
+
+// floor: one slab with the chessboard evaluated per fragment, or one cube per tile (toggle with F)
+bool proceduralFloor = true;
+float floorTileSize = 1.0f;     // Size of each tile on the chessboard
+int floorGridSize = 10;         // Number of tiles along one side, cycled 10/100/1000 with G for stress tests
+
+// vertex layout of the parametric meshes: 12 byte packed or 24 byte float, chosen at startup
+VertexFormat meshVertexFormat = VERTEX_PACKED;
+
+// deferred shading: surface attributes into a G-buffer, then every light once per pixel (toggle with F3)
+bool useDeferredShading = false;
+
+// depth-only pass before the lit floor and boxes: off, on, or on while overdraw is high (cycle with F4)
+DepthPrepassMode depthPrepassMode = DEPTH_PREPASS_AUTO;
+
+// hardware occlusion queries with conditional rendering of the expensive primitives (toggle with 0)
+bool useOcclusionQueries = false;
+
+// frame statistics, printed once per second while enabled (toggle with P)
+bool showFrameStats = false;
+double lastStatsTime = 0.0;
+
 
 // timing
 float deltaTime = 0.0f;    // time between current frame and last frame
@@ -198,11 +263,37 @@ int main()
     // -----------------------------
     glEnable(GL_DEPTH_TEST);
 
+    // programs linked in an earlier run with this driver are loaded from disk instead of compiled, the
+    // rest are compiled on the driver's threads where it has them
+    ShaderCompiler::current().init((GLADloadproc)glfwGetProcAddress);
+    ProgramBinaryCache::current().init((GLADloadproc)glfwGetProcAddress, "shaderPrograms.bin");
+    double shaderStartTime = glfwGetTime();
+
     // build and compile our shader zprogram
     // ------------------------------------
-    Shader lightingShader("vertexShaderForPhongShading.vs", "fragmentShaderForPhongShading.fs");
-    //Shader lightingShader("vertexShaderForGouraudShading.vs", "fragmentShaderForGouraudShading.fs");
-    Shader ourShader("vertexShader.vs", "fragmentShader.fs");
+    // camera, lights and materials come from uniform buffers every program binds as it is linked (see
+    // uniformBlocks.h)
+    // lit programs are compiled per light toggle combination, the first time it is used
+    ShaderVariants lightingVariants("vertexShaderForPhongShading.vs", "fragmentShaderForPhongShading.fs", LIGHTING_DEFINES);
+    //ShaderVariants lightingVariants("vertexShaderForGouraudShading.vs", "fragmentShaderForGouraudShading.fs", LIGHTING_DEFINES);
+    ShaderVariants instancedLightingVariants("vertexShaderForPhongShadingInstanced.vs", "fragmentShaderForPhongShading.fs", LIGHTING_DEFINES);
+    // every compile is issued up front, the expensive lit programs of the startup toggles first; none
+    // of them is waited for here
+    lightingVariants.request(0);
+    instancedLightingVariants.request(0);
+    Shader ourShader("vertexShader.vs", "fragmentShader.fs", nullptr, {}, false);
+    // deferred path: the same vertex shaders write the G-buffer, a full screen pass does the lighting
+    Shader gBufferShader("vertexShaderForPhongShading.vs", "fragmentShaderGBuffer.fs", nullptr, {}, false);
+    Shader gBufferInstancedShader("vertexShaderForPhongShadingInstanced.vs", "fragmentShaderGBuffer.fs", nullptr, {}, false);
+    ShaderVariants deferredLightingVariants("vertexShaderDeferred.vs", "fragmentShaderDeferredLighting.fs", LIGHTING_DEFINES);
+    // depth pre-pass: the Phong vertex transform with nothing behind it
+    Shader depthShader("vertexShaderForPhongShading.vs", "fragmentShaderDepthOnly.fs", nullptr, {}, false);
+    Shader depthInstancedShader("vertexShaderForPhongShadingInstanced.vs", "fragmentShaderDepthOnly.fs", nullptr, {}, false);
+    // drawn with until a lit variant is linked; small enough to be ready by the first frame
+    Shader fallbackShader("vertexShaderForPhongShading.vs", "fragmentShaderFallback.fs");
+    Shader fallbackInstancedShader("vertexShaderForPhongShadingInstanced.vs", "fragmentShaderFallback.fs");
+    Shader deferredFallbackShader("vertexShaderDeferred.vs", "fragmentShaderDeferredFallback.fs");
+    bool shaderStartupReported = false;
 
     // set up vertex data (and buffer(s)) and configure vertex attributes
     // ------------------------------------------------------------------
@@ -292,10 +383,49 @@ int main()
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(0);
 
+    // the box batch reuses the cube buffers and adds per-instance attributes
+    BoxBatch cubeBatch(cubeVBO, cubeEBO);
+    boxBatch = &cubeBatch;
+
+    MeshCache& meshCache = MeshCache::instance();
+    meshCache.setVertexFormat(meshVertexFormat);
     Cone cone = Cone();
     Sphere sphere = Sphere();
     Cylinder cylinder = Cylinder();
 	Hyperboloid hyperboloid = Hyperboloid(0.1f, 0.2f, 0.15f);
+    MeshArena& meshArena = MeshArena::instance(meshVertexFormat);
+    cout << "mesh cache: " << meshCache.getDistinctMeshes() << " distinct meshes for "
+        << meshCache.getHits() + meshCache.getMisses() << " primitives, "
+        << meshArena.getVertexCount() * meshArena.getVertexStride() << " vertex bytes ("
+        << meshArena.getVertexStride() << " per vertex), ACMR " << meshCache.getAcmrBefore() << " -> "
+        << meshCache.getAcmrAfter() << " after vertex cache optimization" << endl;
+
+    // LOD level of every primitive draw site, kept between frames for hysteresis (toggle LOD with L)
+    LodState lampLod[2], postLod[2], hyperboloidLod, shadeLod, coneLod;
+
+    // the two posts never move and share the cylinder's material: baked into world space once, the visible
+    // ones are a single multi-draw
+    glm::mat4 postModels[2];
+    StaticMeshGroup posts;
+    for (int i = 0; i < 2; i++)
+    {
+        postModels[i] = glm::translate(glm::mat4(1.0f), glm::vec3(-4.5f + i, 0.4f, 4.0f));
+        postModels[i] = glm::scale(postModels[i], glm::vec3(1.0f, 2.7f, 1.0f));
+        posts.add(cylinder.getLods(), postModels[i]);
+    }
+
+    // occlusion query mode (toggle with 0): the expensive primitives are drawn only if their bounding
+    // box passed the depth test last frame
+    OcclusionQueries occlusionQueries(lightCubeVAO, ourShader);
+    OcclusionQueryState lampQuery[2], postQuery[2], hyperboloidQuery, shadeQuery;
+
+    // deferred shading targets, sized on first use, and the empty VAO of the full screen triangle
+    GBuffer gBuffer;
+    unsigned int fullscreenVAO;
+    glGenVertexArrays(1, &fullscreenVAO);
+    // GPU time of the scene passes, for comparing forward and deferred
+    GpuTimer sceneTimer;
+    DepthPrepass depthPrepass;
 
 
     //glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
@@ -319,48 +449,24 @@ int main()
         // -----
         processInput(window);
 
+        lightingVariants.resetUniformStats();
+        instancedLightingVariants.resetUniformStats();
+        ourShader.resetUniformStats();
+        gBufferShader.resetUniformStats();
+        gBufferInstancedShader.resetUniformStats();
+        deferredLightingVariants.resetUniformStats();
+        depthShader.resetUniformStats();
+        depthInstancedShader.resetUniformStats();
+        cubeBatch.resetStats();
+        MeshLod::resetStats();
+        Frustum::current().resetStats();
+        MaterialTable::current().resetStats();
+
         // render
         // ------
         glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        // be sure to activate shader when setting uniforms/drawing objects
-        lightingShader.use();
-        lightingShader.setVec3("viewPos", camera.Position);
-
-        // drawLights
-        drawLights(cubeVAO, lightingShader);
-
-        // activate shader
-        lightingShader.use();
-
-        lightingShader.setVec3("directionalLight.direction", 0.5f, -3.0f, -3.0f);
-        if (AmbientON) {
-            lightingShader.setVec3("directionalLight.ambient", 0.2f, 0.2f, 0.2f);
-            lightingShader.setVec3("spotLight.ambient", 0.2f, 0.2f, 0.2f);
-        }
-        if (DiffusionON) {
-            lightingShader.setVec3("directionalLight.diffuse", 0.8f, 0.8f, 0.8f);
-            lightingShader.setVec3("spotLight.diffuse", 0.8f, 0.8f, 0.8f);
-        }
-        if (SpecularON) {
-
-            lightingShader.setVec3("directionalLight.specular", 1.0f, 1.0f, 1.0f);
-            lightingShader.setVec3("spotLight.specular", 1.0f, 1.0f, 1.0f);
-        }
-
-        lightingShader.setBool("directionalLightON", directionalLightOn);
-        lightingShader.setBool("SpotLightON", SpotLightOn);
-
-        lightingShader.setVec3("spotLight.direction", 0.0f, -1.0f, 0.0f);
-        lightingShader.setVec3("spotLight.position", -3.0f, 4.0f, 4.0f);
-
-        lightingShader.setFloat("spotLight.k_c", 1.0f);
-        lightingShader.setFloat("spotLight.k_l", 0.09f);
-        lightingShader.setFloat("spotLight.k_q", 0.032f);
-        lightingShader.setFloat("spotLight.cutOff", glm::cos(glm::radians(35.5f)));
-        lightingShader.setFloat("spotLight.outerCutOff", glm::cos(glm::radians(40.5f)));
-
         // pass projection matrix to shader (note that in this case it could change every frame)
        // glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
         //glm::mat4 projection = glm::ortho(-2.0f, +2.0f, -1.5f, +1.5f, 0.1f, 100.0f);
@@ -374,13 +480,57 @@ int main()
 
         glm::mat4 projection = myProjection(-0.13f, 0.13f, -0.12f, 0.12f, 0.1f, 100.0f);
 
-
-        lightingShader.setMat4("projection", projection);
-
         // camera/view transformation
         glm::mat4 view = camera.GetViewMatrix();
         //glm::mat4 view = basic_camera.createViewMatrix();
-        lightingShader.setMat4("view", view);
+        // one buffer update for every program that reads the camera
+        FrameUniforms::current().set(projection, view, camera.Position);
+        MeshLod::setView(view, projection, (float)SCR_HEIGHT);
+        Frustum::current().update(projection * view);
+        SceneBvh::current().beginFrame(Frustum::current());
+        OcclusionCuller::current().begin(projection * view);
+        addKitchenOccluders(OcclusionCuller::current());
+
+        // lights are shared through uniform buffers; only the ones that changed are uploaded
+        updateLights(LightManager::current());
+        LightManager::current().upload();
+        // and each fragment only walks the lights of its cluster (toggle with F1)
+        int framebufferWidth, framebufferHeight;
+        glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+        LightClusters::current().build(view, projection, framebufferWidth, framebufferHeight, LightManager::current());
+
+        // the lit programs of the current light toggles; switching a light off switches programs, and the
+        // fallback draws for the few frames a new variant is still compiling
+        unsigned int lightingKey = lightingPermutation();
+        Shader& lightingShader = lightingVariants.getOrFallback(lightingKey, fallbackShader);
+        Shader& instancedLightingShader = instancedLightingVariants.getOrFallback(lightingKey, fallbackInstancedShader);
+        if (!shaderStartupReported && &lightingShader != &fallbackShader && &instancedLightingShader != &fallbackInstancedShader)
+        {
+            ShaderCompiler::current().report((glfwGetTime() - shaderStartTime) * 1000.0, ProgramBinaryCache::current().getHits());
+            shaderStartupReported = true;
+        }
+
+        // forward shades while drawing; deferred draws surface attributes first and lights them afterwards
+        bool deferred = useDeferredShading;
+        Shader& sceneShader = deferred ? gBufferShader : lightingShader;
+        Shader& sceneInstancedShader = deferred ? gBufferInstancedShader : instancedLightingShader;
+        sceneTimer.begin();
+        if (deferred)
+        {
+            gBuffer.resize(framebufferWidth, framebufferHeight);
+            gBuffer.bindForGeometry();
+        }
+
+        // be sure to activate shader when setting uniforms/drawing objects
+        // the camera and lights are in the shared blocks; only the clusters are bound per program
+        setUpLighting(sceneShader);
+        setUpLighting(sceneInstancedShader);
+
+        // drawLights
+        drawLights(cubeVAO, sceneShader);
+
+        // activate shader
+        sceneShader.use();
 
         // Modelling Transformation
         glm::mat4 identityMatrix = glm::mat4(1.0f); // make sure to initialize matrix to identity matrix first
@@ -391,23 +541,43 @@ int main()
         rotateZMatrix = glm::rotate(identityMatrix, glm::radians(rotateAngle_Z), glm::vec3(0.0f, 0.0f, 1.0f));
         scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X, scale_Y, scale_Z));
         model = translateMatrix * rotateXMatrix * rotateYMatrix * rotateZMatrix * scaleMatrix;
-        lightingShader.setMat4("model", model);
+        sceneShader.setModel(Affine(model));
 
         //glBindVertexArray(cubeVAO);
         //glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
         //glDrawArrays(GL_TRIANGLES, 0, 36);
 
-        //draw floor
-        drawFloor(cubeVAO, lightingShader);
         //draw Tables
-        drawKitchen(cubeVAO, lightingShader);
+        drawKitchen(cubeVAO, sceneShader);
         //draw Walls
-        drawWalls(cubeVAO, lightingShader);
+        drawWalls(cubeVAO, sceneShader);
+        //draw floor; tiles join the batch, the procedural slab is drawn with it below
+        if (!proceduralFloor)
+            drawFloor(cubeVAO, sceneShader);
+
+        // the floor slab and the batched boxes overlap the most; with the pre-pass their depth goes down
+        // first and the lit draws shade only the visible fragment of each pixel. It needs the boxes
+        // batched, and the G-buffer pass writes too little per fragment to be worth it
+        depthPrepass.mode = depthPrepassMode;
+        if (depthPrepass.isActive() && useBoxBatch && !deferred)
+        {
+            depthPrepass.beginDepthPass();
+            if (proceduralFloor)
+                drawFloor(cubeVAO, depthShader);
+            cubeBatch.drawDepth(depthInstancedShader);
+        }
+        depthPrepass.beginShadingPass();
+        if (proceduralFloor)
+            drawFloor(cubeVAO, sceneShader);
+        // every box recorded above goes out in a single instanced draw
+        if (useBoxBatch)
+            cubeBatch.draw(sceneInstancedShader);
+        // the primitives below test against the pre-pass depth as usual
+        depthPrepass.endShadingPass(framebufferWidth * framebufferHeight);
 
         // also draw the lamp object(s)
-        ourShader.use();
-        ourShader.setMat4("projection", projection);
-        ourShader.setMat4("view", view);
+        occlusionQueries.enabled = useOcclusionQueries;
+        occlusionQueries.beginFrame(view);
 
         // we now draw as many light bulbs as we have point lights.
         glBindVertexArray(lightCubeVAO);
@@ -416,29 +586,26 @@ int main()
             model = glm::mat4(1.0f);
             model = glm::translate(model, pointLightPositions[i]);
             model = glm::scale(model, glm::vec3(0.2f)); // Make it a smaller cube
-            ourShader.setMat4("model", model);
-            ourShader.setVec3("color", glm::vec3(0.8f, 0.8f, 0.8f));
-            sphere.drawSphere(lightingShader, model);
+            bool conditional = occlusionQueries.beginConditional(lampQuery[i], model, sphere.getMesh().boundsMin, sphere.getMesh().boundsMax);
+            sphere.drawSphere(sceneShader, model, &lampLod[i]);
+            occlusionQueries.endConditional(conditional);
             //glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
             //glDrawArrays(GL_TRIANGLES, 0, 36);
         }
 
         // cylinder
+        // conditional rendering is per draw, so with occlusion queries each post is drawn on its own
+        if (useOcclusionQueries)
         {
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, glm::vec3(-4.5f, 0.4f, 4.0f));
-            model = glm::scale(model, glm::vec3(1.0f, 2.7f, 1.0f));
-            ourShader.setMat4("model", model);
-            ourShader.setVec3("color", glm::vec3(1.0f, 0.8f, 0.8f));
-            cylinder.drawCylinder(lightingShader, model);
-
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, glm::vec3(-3.5f, 0.4f, 4.0f));
-            model = glm::scale(model, glm::vec3(1.0f, 2.7f, 1.0f));
-            ourShader.setMat4("model", model);
-            ourShader.setVec3("color", glm::vec3(1.0f, 0.8f, 0.8f));
-            cylinder.drawCylinder(lightingShader, model);
+            for (int i = 0; i < 2; i++)
+            {
+                bool conditional = occlusionQueries.beginConditional(postQuery[i], postModels[i], cylinder.getMesh().boundsMin, cylinder.getMesh().boundsMax);
+                cylinder.drawCylinder(sceneShader, postModels[i], &postLod[i]);
+                occlusionQueries.endConditional(conditional);
+            }
         }
+        else
+            cylinder.drawGroup(sceneShader, posts, postLod);
 
 
         // hyperboloid
@@ -446,16 +613,16 @@ int main()
 			model = glm::mat4(1.0f);
 			model = glm::translate(model, glm::vec3(0.0f, -0.2f, 0.8f));
             model = glm::scale(model, glm::vec3(1.0f, 1.0f, 0.5f));
-			ourShader.setMat4("model", model);
-			ourShader.setVec3("color", glm::vec3(1.0f, 0.8f, 0.8f));
-			hyperboloid.drawHyperboloid(lightingShader, model);
+			bool conditional = occlusionQueries.beginConditional(hyperboloidQuery, model, hyperboloid.getMesh().boundsMin, hyperboloid.getMesh().boundsMax);
+			hyperboloid.drawHyperboloid(sceneShader, model, &hyperboloidLod);
+			occlusionQueries.endConditional(conditional);
             
             model = glm::mat4(1.0f);
             model = glm::translate(model, glm::vec3(0.0f, 0.35f, 0.8f));
             model = glm::scale(model, glm::vec3(0.4f,0.05f,0.4f));
-            ourShader.setMat4("model", model);
-            ourShader.setVec3("color", glm::vec3(0.8f, 0.8f, 0.8f));
-            sphere.drawSphere(lightingShader, model);
+            conditional = occlusionQueries.beginConditional(shadeQuery, model, sphere.getMesh().boundsMin, sphere.getMesh().boundsMax);
+            sphere.drawSphere(sceneShader, model, &shadeLod);
+            occlusionQueries.endConditional(conditional);
         }
 
         // cone
@@ -463,27 +630,104 @@ int main()
             model = glm::mat4(1.0f);
             model = glm::translate(model, glm::vec3(0.0f, 1.0f, 4.0f));
             model = glm::scale(model, glm::vec3(0.4f, 0.4f, 0.4f));
-            ourShader.setMat4("model", model);
-            ourShader.setVec3("color", glm::vec3(1.0f, 0.8f, 0.8f));
-            cone.drawCone(lightingShader, model);
+            cone.drawCone(sceneShader, model, &coneLod);
         }
 
+        // lighting pass: one full screen triangle, Phong evaluated once per covered pixel; a light toggle
+        // never seen before shades with the fixed light fallback until its variant is linked
+        if (deferred)
+        {
+            Shader& deferredLightingShader = deferredLightingVariants.getOrFallback(lightingKey, deferredFallbackShader);
+            gBuffer.bindForLighting();
+            glDisable(GL_DEPTH_TEST);
+            if (&deferredLightingShader != &deferredFallbackShader)
+            {
+                setUpLighting(deferredLightingShader);
+                deferredLightingShader.setMat4("inverseProjectionView", glm::inverse(projection * view));
+            }
+            else
+                deferredLightingShader.use();
+            gBuffer.setSamplers(deferredLightingShader);
+            glBindVertexArray(fullscreenVAO);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+            glBindVertexArray(0);
+            glEnable(GL_DEPTH_TEST);
+            gBuffer.copyDepthToDefault();
+        }
+        sceneTimer.end();
+
+        SceneBvh::current().endFrame();
+
 
 
 
         if (glfwGetKey(window, GLFW_KEY_5) == GLFW_PRESS)
         {
-            ambienton_off(lightingShader);
+            ambienton_off();
         }
         if (glfwGetKey(window, GLFW_KEY_6) == GLFW_PRESS)
         {
-            diffuse_on_off(lightingShader);
+            diffuse_on_off();
         }
         if (glfwGetKey(window, GLFW_KEY_7) == GLFW_PRESS)
         {
-            specular_on_off(lightingShader);
+            specular_on_off();
         }
 
+        if (showFrameStats && currentFrame - lastStatsTime >= 1.0)
+        {
+            unsigned int nameLookups = lightingVariants.getNameLookups() + instancedLightingVariants.getNameLookups() + ourShader.getNameLookups()
+                + gBufferShader.getNameLookups() + gBufferInstancedShader.getNameLookups() + deferredLightingVariants.getNameLookups()
+                + depthShader.getNameLookups() + depthInstancedShader.getNameLookups();
+            unsigned int handleUploads = lightingVariants.getHandleUploads() + instancedLightingVariants.getHandleUploads() + ourShader.getHandleUploads()
+                + gBufferShader.getHandleUploads() + gBufferInstancedShader.getHandleUploads() + deferredLightingVariants.getHandleUploads()
+                + depthShader.getHandleUploads() + depthInstancedShader.getHandleUploads();
+            // only handle uploads skip the lookup; a set by name still hashes into the table, though no driver call
+            cout << "uniform sets per frame: " << handleUploads << " through pre-resolved handles, "
+                << nameLookups << " by name" << endl;
+            unsigned int uploadsIssued = lightingVariants.getUploadsIssued() + instancedLightingVariants.getUploadsIssued() + ourShader.getUploadsIssued()
+                + gBufferShader.getUploadsIssued() + gBufferInstancedShader.getUploadsIssued() + deferredLightingVariants.getUploadsIssued()
+                + depthShader.getUploadsIssued() + depthInstancedShader.getUploadsIssued();
+            unsigned int uploadsSkipped = lightingVariants.getUploadsSkipped() + instancedLightingVariants.getUploadsSkipped() + ourShader.getUploadsSkipped()
+                + gBufferShader.getUploadsSkipped() + gBufferInstancedShader.getUploadsSkipped() + deferredLightingVariants.getUploadsSkipped()
+                + depthShader.getUploadsSkipped() + depthInstancedShader.getUploadsSkipped();
+            cout << "uniform uploads per frame: " << uploadsIssued << " issued, " << uploadsSkipped << " skipped as unchanged" << endl;
+            cout << "lit program variants: " << lightingVariants.getVariantCount() + instancedLightingVariants.getVariantCount()
+                + deferredLightingVariants.getVariantCount() << " compiled, current key " << lightingKey << endl;
+            cout << (useDeferredShading ? "deferred" : "forward") << " scene passes: " << sceneTimer.getMilliseconds() << " ms GPU";
+            if (useDeferredShading)
+                cout << " (" << GBuffer::getBytesPerPixel() * framebufferWidth * framebufferHeight / 1024 << " KB G-buffer)";
+            cout << endl;
+            const char* prepassModes[] = { "off", "on", "auto" };
+            cout << "depth pre-pass: " << prepassModes[depthPrepassMode] << (depthPrepass.isActive() ? " (active)" : " (inactive)")
+                << ", " << depthPrepass.getOverdraw() << " floor and box fragments per pixel" << endl;
+            cout << "boxes: " << cubeBatch.getBoxesDrawn() << " in " << cubeBatch.getDrawCalls() << " instanced draw call(s)" << endl;
+            cout << "frustum: " << Frustum::current().getVisible() << " visible, " << Frustum::current().getCulled() << " culled" << endl;
+            cout << "occlusion: " << OcclusionCuller::current().getOccluded() << " of " << OcclusionCuller::current().getTested()
+                << " tested hidden behind " << OcclusionCuller::current().getOccluders() << " occluder(s)" << endl;
+            if (useOcclusionQueries)
+                cout << "occlusion queries: " << occlusionQueries.getHidden() << " of " << occlusionQueries.getQueried()
+                    << " answered box queries hidden" << endl;
+            cout << "lights: " << LightManager::current().getPointLightCount() << " point, " << LightManager::current().getSpotLightCount()
+                << " spot, " << LightManager::current().getUploadedBytes() << " bytes uploaded";
+            if (LightManager::current().getDroppedPointLights() > 0 || LightManager::current().getDroppedSpotLights() > 0)
+                cout << " (" << LightManager::current().getDroppedPointLights() << " point, " << LightManager::current().getDroppedSpotLights()
+                    << " spot dropped past the block sizes)";
+            cout << endl;
+            cout << "shared uniform blocks: " << FrameUniforms::current().getUploadedBytes() << " camera bytes, "
+                << MaterialTable::current().getUploadedBytes() << " material bytes uploaded; "
+                << MaterialTable::current().getMaterialCount() << " materials" << endl;
+            if (LightClusters::current().enabled)
+                cout << "light clusters: " << LightClusters::current().getPairs() << " light/cluster pairs, at most "
+                    << LightClusters::current().getMaxPerCluster() << " per cluster, built in " << LightClusters::current().getBuildTime()
+                    << " ms on " << LightClusters::current().getThreadCount() << " thread(s)"
+                    << (LightClusters::current().getOverflow() ? " (lists truncated)" : "") << endl;
+            cout << "bvh: " << SceneBvh::current().getBvh().getObjectCount() << " objects in " << SceneBvh::current().getBvh().getNodeCount()
+                << " nodes, " << SceneBvh::current().getRefits() << " refit(s), " << SceneBvh::current().getBuilds() << " build(s)" << endl;
+            cout << "primitive draws per LOD level: " << MeshLod::getDraws(0) << " / " << MeshLod::getDraws(1)
+                << " / " << MeshLod::getDraws(2) << endl;
+            lastStatsTime = currentFrame;
+        }
 
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
         // -------------------------------------------------------------------------------
@@ -497,6 +741,27 @@ int main()
     glDeleteVertexArrays(1, &lightCubeVAO);
     glDeleteBuffers(1, &cubeVBO);
     glDeleteBuffers(1, &cubeEBO);
+    boxBatch = nullptr;
+    for (int i = 0; i < 2; i++)
+    {
+        occlusionQueries.release(lampQuery[i]);
+        occlusionQueries.release(postQuery[i]);
+    }
+    occlusionQueries.release(hyperboloidQuery);
+    occlusionQueries.release(shadeQuery);
+    posts.release();
+    MeshArena::instance(VERTEX_FLOAT).release();
+    MeshArena::instance(VERTEX_PACKED).release();
+    LightManager::current().release();
+    FrameUniforms::current().release();
+    MaterialTable::current().release();
+    LightClusters::current().release();
+    gBuffer.release();
+    sceneTimer.release();
+    depthPrepass.release();
+    glDeleteVertexArrays(1, &fullscreenVAO);
+    // including the variants compiled while running
+    ProgramBinaryCache::current().save();
 
     // glfw: terminate, clearing all previously allocated GLFW resources.
     // ------------------------------------------------------------------
@@ -505,15 +770,33 @@ int main()
 }
 
 void drawCube(unsigned int& cubeVAO, Shader& lightingShader, glm::mat4 model = glm::mat4(1.0f), float r = 1.0f, float g = 1.0f, float b = 1.0f, float shininess = 32.0f)
+{
+    // the cube VBO spans (0,0,0)-(1,1,1)
+    if (!SceneBvh::current().isVisible(model, glm::vec3(0.0f), glm::vec3(1.0f))
+        || !OcclusionCuller::current().isVisible(model, glm::vec3(0.0f), glm::vec3(1.0f)))
+        return;
+
+    if (useBoxBatch && boxBatch != nullptr)
+    {
+        boxBatch->add(model, glm::vec3(r, g, b), glm::vec3(r, g, b), glm::vec3(0.8f, 0.8f, 0.8f), shininess);
+        return;
+    }
+    drawCubeImmediate(cubeVAO, lightingShader, model, r, g, b, shininess);
+}
+
+// draws right away with lightingShader, bypassing the box batch
+void drawCubeImmediate(unsigned int& cubeVAO, Shader& lightingShader, glm::mat4 model, float r, float g, float b, float shininess)
 {
     lightingShader.use();
 
-    lightingShader.setVec3("material.ambient", glm::vec3(r, g, b));
-    lightingShader.setVec3("material.diffuse", glm::vec3(r, g, b));
-    lightingShader.setVec3("material.specular", glm::vec3(0.8f, 0.8f, 0.8f));
-    lightingShader.setFloat("material.shininess", shininess);
+    const MaterialUniforms& uniforms = lightingShader.materialUniforms;
+    int material = MaterialTable::current().index(glm::vec3(r, g, b), glm::vec3(r, g, b), glm::vec3(0.8f, 0.8f, 0.8f), shininess);
+    lightingShader.setInt(uniforms.materialIndex, material);
 
-    lightingShader.setMat4("model", model);
+    lightingShader.setModel(Affine(model));
+    // the cube VBO is plain floats; undo any packed mesh dequantization
+    lightingShader.setVec3(uniforms.positionScale, glm::vec3(1.0f));
+    lightingShader.setVec3(uniforms.positionBias, glm::vec3(0.0f));
 
     glBindVertexArray(cubeVAO);
     glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
@@ -525,8 +808,41 @@ void drawFloor(unsigned int& cubeVAO, Shader& lightingShader)
     glm::mat4 identityMatrix = glm::mat4(1.0f);
     glm::mat4 translate = glm::mat4(1.0f);
     glm::mat4 scale = glm::mat4(1.0f);
-    float tileSize = 1.0f; // Size of each tile on the chessboard
-    int gridSize = 10;     // Number of tiles along one side (10x10)
+    float tileSize = floorTileSize;
+    int gridSize = floorGridSize;
+    float origin = -0.5f * gridSize * tileSize;  // board centered on the room
+
+    if (proceduralFloor)
+    {
+        // whole board as one slab; the fragment shader picks the tile color from the world position
+        const CheckerUniforms& checker = lightingShader.checkerUniforms;
+        lightingShader.setBool(checker.checkerFloor, true);
+        lightingShader.setVec2(checker.checkerOrigin, glm::vec2(origin, origin));
+        lightingShader.setFloat(checker.checkerTileSize, tileSize);
+        lightingShader.setInt(checker.checkerGridSize, gridSize);
+
+        scale = glm::scale(identityMatrix, glm::vec3(gridSize * tileSize, 0.2f, gridSize * tileSize));
+        translate = glm::translate(identityMatrix, glm::vec3(origin, -1.0f, origin));
+        drawCubeImmediate(cubeVAO, lightingShader, translate * scale, 0.8f, 0.8f, 0.8f, 32.0f);
+
+        lightingShader.setBool(checker.checkerFloor, false);
+        return;
+    }
+
+    // tile matrices are composed in one batched pass whenever the board changes, not per tile per frame
+    static TransformStore tiles;
+    static int tilesGridSize = 0;
+    static float tilesTileSize = 0.0f;
+    if (tilesGridSize != gridSize || tilesTileSize != tileSize)
+    {
+        tiles.clear();
+        for (int x = 0; x < gridSize; x++)
+            for (int z = 0; z < gridSize; z++)
+                tiles.add(-1, glm::vec3(x * tileSize + origin, -1.0f, z * tileSize + origin), glm::vec3(0.0f), glm::vec3(tileSize, 0.2f, tileSize));
+        tilesGridSize = gridSize;
+        tilesTileSize = tileSize;
+    }
+    tiles.update();
 
     for (int x = 0; x < gridSize; x++) {
         for (int z = 0; z < gridSize; z++) {
@@ -534,21 +850,13 @@ void drawFloor(unsigned int& cubeVAO, Shader& lightingShader)
             bool isDark = (x + z) % 2 == 0;
             float color = isDark ? 0.2f : 0.8f; // Dark tile: 0.2, Light tile: 0.8
 
-            scale = glm::scale(identityMatrix, glm::vec3(tileSize, 0.2f, tileSize));
-            translate = glm::translate(identityMatrix, glm::vec3(x * tileSize - 5.0f, -1.0f, z * tileSize - 5.0f));
-            glm::mat4 model = translate * scale;
-
-            drawCube(cubeVAO, lightingShader, model, color, color, color, 32.0f);
+            drawCube(cubeVAO, lightingShader, tiles.getWorld(x * gridSize + z), color, color, color, 32.0f);
         }
     }
 }
 
 void drawLights(unsigned int& cubeVAO, Shader& lightingShader){
     lightingShader.use();
-    // point light 1
-    pointlight1.setUpPointLight(lightingShader);
-    // point light 2
-    pointlight2.setUpPointLight(lightingShader);
     // base
     glm::mat4 identityMatrix = glm::mat4(1.0f);
     glm::mat4 translate = glm::mat4(1.0f);
@@ -576,14 +884,10 @@ void drawKitchen(unsigned int& cubeVAO, Shader& lightingShader)
     glm::mat4 model;
 
     // Left Shelves
-    scale = glm::scale(identityMatrix, glm::vec3(1.5f, 2.0f, 7.0f));
-    translate = glm::translate(identityMatrix, glm::vec3(3.0f, -0.8f, -2.2f));
-    model = translate * scale;
+    model = leftShelvesModel();
     drawCube(cubeVAO, lightingShader, model, 0.212f, 0.067f, 0.031f, 32.0f);
     // Front Shelves
-    scale = glm::scale(identityMatrix, glm::vec3(7.0f, 2.0f, 1.5f));
-    translate = glm::translate(identityMatrix, glm::vec3(-3.0f, -0.8f, 3.3f));
-    model = translate * scale;
+    model = frontShelvesModel();
     drawCube(cubeVAO, lightingShader, model, 0.212f, 0.067f, 0.031f, 32.0f);
 
     //// Gas Stove (base)
@@ -615,9 +919,7 @@ void leftWall(unsigned int& cubeVAO, Shader& lightingShader)
     glm::mat4 model = translate * scale;
 
     //wall
-    scale = glm::scale(identityMatrix, glm::vec3(0.1, 5.0, 10.0));
-    translate = glm::translate(identityMatrix, glm::vec3(4.9, -0.8, -5.0));
-    model = translate * scale;
+    model = leftWallModel();
     drawCube(cubeVAO, lightingShader, model, 0.5, 0.5, 0.5, 32.0);
 
 }
@@ -632,9 +934,7 @@ void rightWall(unsigned int& cubeVAO, Shader& lightingShader)
     glm::mat4 model = translate * scale;
 
     //wall
-    scale = glm::scale(identityMatrix, glm::vec3(0.1, 5.0, 10.0));
-    translate = glm::translate(identityMatrix, glm::vec3(-5.0, -0.8, -5.0));
-    model = translate * scale;
+    model = rightWallModel();
     drawCube(cubeVAO, lightingShader, model, 0.5, 0.5, 0.5, 32.0);
 
 }
@@ -648,9 +948,7 @@ void frontWall(unsigned int& cubeVAO, Shader& lightingShader)
     glm::mat4 rotation = glm::mat4(1.0f);
     glm::mat4 model = translate * scale;
     //wall
-    scale = glm::scale(identityMatrix, glm::vec3(10.0, 5.0, 0.1));
-    translate = glm::translate(identityMatrix, glm::vec3(-5.0, -0.8, 4.9));
-    model = translate * scale;
+    model = frontWallModel();
     drawCube(cubeVAO, lightingShader, model, 0.5, 0.5, 0.5, 32.0);
 
     //scale = glm::scale(identityMatrix, glm::vec3(1.7, 1.5, 0.7));
@@ -666,6 +964,96 @@ void drawWalls(unsigned int& cubeVAO, Shader& lightingShader) {
     rightWall(cubeVAO, lightingShader);
 }
 
+// unit cube transforms of the large kitchen boxes, shared by drawing and the occlusion pass
+glm::mat4 leftShelvesModel()
+{
+    return glm::translate(glm::mat4(1.0f), glm::vec3(3.0f, -0.8f, -2.2f)) * glm::scale(glm::mat4(1.0f), glm::vec3(1.5f, 2.0f, 7.0f));
+}
+glm::mat4 frontShelvesModel()
+{
+    return glm::translate(glm::mat4(1.0f), glm::vec3(-3.0f, -0.8f, 3.3f)) * glm::scale(glm::mat4(1.0f), glm::vec3(7.0f, 2.0f, 1.5f));
+}
+glm::mat4 leftWallModel()
+{
+    return glm::translate(glm::mat4(1.0f), glm::vec3(4.9f, -0.8f, -5.0f)) * glm::scale(glm::mat4(1.0f), glm::vec3(0.1f, 5.0f, 10.0f));
+}
+glm::mat4 rightWallModel()
+{
+    return glm::translate(glm::mat4(1.0f), glm::vec3(-5.0f, -0.8f, -5.0f)) * glm::scale(glm::mat4(1.0f), glm::vec3(0.1f, 5.0f, 10.0f));
+}
+glm::mat4 frontWallModel()
+{
+    return glm::translate(glm::mat4(1.0f), glm::vec3(-5.0f, -0.8f, 4.9f)) * glm::scale(glm::mat4(1.0f), glm::vec3(10.0f, 5.0f, 0.1f));
+}
+
+// walls and shelves hide most of the room; everything else is tested against them before it is drawn
+void addKitchenOccluders(OcclusionCuller& culler)
+{
+    glm::mat4 occluders[] = { leftWallModel(), rightWallModel(), frontWallModel(), leftShelvesModel(), frontShelvesModel() };
+    for (const glm::mat4& model : occluders)
+        culler.addOccluder(model, glm::vec3(0.0f), glm::vec3(1.0f));
+}
+
+// light clusters for one lit program; camera and lights come from the shared uniform blocks
+void setUpLighting(Shader& lightingShader)
+{
+    lightingShader.use();
+    LightClusters::current().bind(lightingShader);
+}
+
+// point, spot and directional lights of the kitchen; unchanged lights cost nothing at upload time
+void updateLights(LightManager& lights)
+{
+    // point light 1
+    pointlight1.setUpPointLight(lights);
+    // point light 2
+    pointlight2.setUpPointLight(lights);
+
+    SpotLightData spot;
+    spot.position = glm::vec3(-3.0f, 4.0f, 4.0f);
+    spot.direction = glm::vec3(0.0f, -1.0f, 0.0f);
+    spot.ambient = glm::vec3(0.2f, 0.2f, 0.2f);
+    spot.diffuse = glm::vec3(0.8f, 0.8f, 0.8f);
+    spot.specular = glm::vec3(1.0f, 1.0f, 1.0f);
+    spot.k_c = 1.0f;
+    spot.k_l = 0.09f;
+    spot.k_q = 0.032f;
+    spot.cutOff = glm::cos(glm::radians(35.5f));
+    spot.outerCutOff = glm::cos(glm::radians(40.5f));
+    if (spotLightSlot < 0)
+        spotLightSlot = lights.addSpotLight(spot);
+    else
+        lights.setSpotLight(spotLightSlot, spot);
+    lights.setSpotLightEnabled(spotLightSlot, SpotLightOn);
+
+    // switched off by the program permutation, not zeroed here
+    DirectionalLightData directional;
+    directional.direction = glm::vec3(0.5f, -3.0f, -3.0f);
+    directional.ambient = glm::vec3(0.2f, 0.2f, 0.2f);
+    directional.diffuse = glm::vec3(0.8f, 0.8f, 0.8f);
+    directional.specular = glm::vec3(1.0f, 1.0f, 1.0f);
+    lights.setDirectionalLight(directional);
+
+    // up to 250 lights on a 16x16 grid just above the floor, created once and switched on as needed
+    const int STRESS_GRID = 16;
+    if (stressLightCount > 0 && stressLights.empty())
+        for (int i = 0; i < 250; i++)
+        {
+            PointLightData light;
+            light.position = glm::vec3(-5.0f + 10.0f * (i % STRESS_GRID + 0.5f) / STRESS_GRID, -0.7f,
+                -5.0f + 10.0f * (i / STRESS_GRID + 0.5f) / STRESS_GRID);
+            glm::vec3 color(0.5f + 0.5f * glm::cos(i * 0.7f), 0.5f + 0.5f * glm::cos(i * 1.3f + 2.0f), 0.5f + 0.5f * glm::cos(i * 2.1f + 4.0f));
+            light.diffuse = 0.4f * color;
+            light.specular = 0.2f * color;
+            light.k_c = 1.0f;
+            light.k_l = 1.4f;
+            light.k_q = 7.2f;
+            stressLights.push_back(lights.addPointLight(light));
+        }
+    for (size_t i = 0; i < stressLights.size(); i++)
+        lights.setPointLightEnabled(stressLights[i], (int)i < stressLightCount);
+}
+
 
 // process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
 // ---------------------------------------------------------------------------------------------------------
@@ -787,77 +1175,45 @@ void processInput(GLFWwindow* window)
     //}
 
 }
-void ambienton_off(Shader& lightingShader)
+// the ambient, diffuse and specular toggles pick the lit program permutation (see lightingPermutation)
+void ambienton_off()
 {
     double currentTime = glfwGetTime();
     if (currentTime - lastKeyPressTime < keyPressDelay) return;
-    lightingShader.use();
-    if (AmbientON)
-    {
-        pointlight1.turnAmbientOff();
-        pointlight2.turnAmbientOff();
-        lightingShader.setVec3("directionalLight.ambient", 0.0f, 0.0f, 0.0f);
-        lightingShader.setVec3("spotLight.ambient", 0.0f, 0.0f, 0.0f);
-        AmbientON = !AmbientON;
-        lastKeyPressTime = currentTime;
-    }
-    else
-    {
-        pointlight1.turnAmbientOn();
-        pointlight2.turnAmbientOn();
-        lightingShader.setVec3("directionalLight.ambient", 0.2f, 0.2f, 0.2f);
-        lightingShader.setVec3("spotLight.ambient", 0.2f, 0.2f, 0.2f);
-        AmbientON = !AmbientON;
-        lastKeyPressTime = currentTime;
-    }
+    AmbientON = !AmbientON;
+    lastKeyPressTime = currentTime;
 }
-void diffuse_on_off(Shader& lightingShader)
+void diffuse_on_off()
 {
     double currentTime = glfwGetTime();
     if (currentTime - lastKeyPressTime < keyPressDelay) return;
-    lightingShader.use();
-    if (DiffusionON)
-    {
-        pointlight1.turnDiffuseOff();
-        pointlight2.turnDiffuseOff();
-        lightingShader.setVec3("directionalLight.diffuse", 0.0f, 0.0f, 0.0f);
-        lightingShader.setVec3("spotLight.diffuse", 0.0f, 0.0f, 0.0f);
-        DiffusionON = !DiffusionON;
-        lastKeyPressTime = currentTime;
-    }
-    else
-    {
-        pointlight1.turnDiffuseOn();
-        pointlight2.turnDiffuseOn();
-        lightingShader.setVec3("directionalLight.diffuse", 0.8f, 0.8f, 0.8f);
-        lightingShader.setVec3("spotLight.diffuse", 0.8f, 0.8f, 0.8f);
-        DiffusionON = !DiffusionON;
-        lastKeyPressTime = currentTime;
-    }
+    DiffusionON = !DiffusionON;
+    lastKeyPressTime = currentTime;
 }
-void specular_on_off(Shader& lightingShader)
+void specular_on_off()
 {
     double currentTime = glfwGetTime();
     if (currentTime - lastKeyPressTime < keyPressDelay) return;
-    lightingShader.use();
-    if (SpecularON)
-    {
-        pointlight1.turnSpecularOff();
-        pointlight2.turnSpecularOff();
-        lightingShader.setVec3("directionalLight.specular", 0.0f, 0.0f, 0.0f);
-        lightingShader.setVec3("spotLight.specular", 0.0f, 0.0f, 0.0f);
-        SpecularON = !SpecularON;
-        lastKeyPressTime = currentTime;
-    }
-    else
-    {
-        pointlight1.turnSpecularOn();
-        pointlight2.turnSpecularOn();
-        lightingShader.setVec3("directionalLight.specular", 1.0f, 1.0f, 1.0f);
-        lightingShader.setVec3("spotLight.specular", 1.0f, 1.0f, 1.0f);
-        SpecularON = !SpecularON;
-        lastKeyPressTime = currentTime;
-    }
+    SpecularON = !SpecularON;
+    lastKeyPressTime = currentTime;
+}
+
+// key of the lit program variant for the current toggles; a light with nothing in its buffer is
+// compiled out too
+unsigned int lightingPermutation()
+{
+    unsigned int key = 0;
+    if (!directionalLightOn)
+        key |= LIGHTING_NO_DIRECTIONAL;
+    if (LightManager::current().getSpotLightCount() == 0)
+        key |= LIGHTING_NO_SPOT;
+    if (!AmbientON)
+        key |= LIGHTING_NO_AMBIENT;
+    if (!DiffusionON)
+        key |= LIGHTING_NO_DIFFUSE;
+    if (!SpecularON)
+        key |= LIGHTING_NO_SPECULAR;
+    return key;
 }
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods)
 {
@@ -942,6 +1298,87 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
             SpotLightOn = !SpotLightOn;
         }
     }
+    if (key == GLFW_KEY_F && action == GLFW_PRESS)
+    {
+        proceduralFloor = !proceduralFloor;
+    }
+    if (key == GLFW_KEY_G && action == GLFW_PRESS)
+    {
+        if (floorGridSize == 10)
+            floorGridSize = 100;
+        else if (floorGridSize == 100)
+            floorGridSize = 1000;
+        else
+            floorGridSize = 10;
+        cout << "floor grid: " << floorGridSize << "x" << floorGridSize << endl;
+    }
+    if (key == GLFW_KEY_I && action == GLFW_PRESS)
+    {
+        useBoxBatch = !useBoxBatch;
+    }
+    if (key == GLFW_KEY_C && action == GLFW_PRESS)
+    {
+        Frustum::current().enabled = !Frustum::current().enabled;
+        cout << "frustum culling " << (Frustum::current().enabled ? "on" : "off") << endl;
+    }
+    if (key == GLFW_KEY_L && action == GLFW_PRESS)
+    {
+        MeshLod::enabled() = !MeshLod::enabled();
+        cout << "mesh LOD " << (MeshLod::enabled() ? "on" : "off") << endl;
+    }
+    if (key == GLFW_KEY_F1 && action == GLFW_PRESS)
+    {
+        LightClusters::current().enabled = !LightClusters::current().enabled;
+        cout << "clustered lighting " << (LightClusters::current().enabled ? "on" : "off") << endl;
+    }
+    if (key == GLFW_KEY_F2 && action == GLFW_PRESS)
+    {
+        if (stressLightCount == 0)
+            stressLightCount = 100;
+        else if (stressLightCount == 100)
+            stressLightCount = 250;
+        else
+            stressLightCount = 0;
+        cout << "extra point lights: " << stressLightCount << endl;
+    }
+    if (key == GLFW_KEY_F3 && action == GLFW_PRESS)
+    {
+        useDeferredShading = !useDeferredShading;
+        cout << (useDeferredShading ? "deferred" : "forward") << " shading" << endl;
+    }
+    if (key == GLFW_KEY_F4 && action == GLFW_PRESS)
+    {
+        depthPrepassMode = (DepthPrepassMode)((depthPrepassMode + 1) % 3);
+        const char* modes[] = { "off", "on", "auto" };
+        cout << "depth pre-pass " << modes[depthPrepassMode] << endl;
+    }
+    if (key == GLFW_KEY_P && action == GLFW_PRESS)
+    {
+        showFrameStats = !showFrameStats;
+    }
+    if (key == GLFW_KEY_0 && action == GLFW_PRESS)
+    {
+        useOcclusionQueries = !useOcclusionQueries;
+        cout << "occlusion queries " << (useOcclusionQueries ? "on" : "off") << endl;
+    }
+    if (key == GLFW_KEY_8 && action == GLFW_PRESS)
+    {
+        OcclusionCuller::current().enabled = !OcclusionCuller::current().enabled;
+        cout << "occlusion culling " << (OcclusionCuller::current().enabled ? "on" : "off") << endl;
+    }
+    if (key == GLFW_KEY_9 && action == GLFW_PRESS)
+    {
+        // what the camera looks at and what is within reach, both answered by the scene BVH
+        float distance;
+        int object = SceneBvh::current().pick(camera.Position, -camera.Front, 100.0f, distance);
+        std::vector<int> nearby;
+        SceneBvh::current().nearby(camera.Position, 1.0f, nearby);
+        if (object >= 0)
+            cout << "looking at object " << object << " at " << distance << ", ";
+        else
+            cout << "looking at nothing, ";
+        cout << nearby.size() << " object(s) within 1 unit" << endl;
+    }
 }
 
 // glfw: whenever the window size changed (by OS or user resize) this callback function executes
@@ -0,0 +1,129 @@
+//
+//  materialTable.h
+//  every distinct material of the scene in one std140 block, drawn by index
+//
+
+#ifndef MATERIAL_TABLE_H
+#define MATERIAL_TABLE_H
+
+#include <cstring>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "uniformBlocks.h"
+
+// array size of the Materials block; 256 entries of 48 bytes stay below the 16 KB GL 3.3 guarantees
+const int MAX_MATERIALS = 256;
+
+// std140 element of the Materials block; shininess fills the slot after ambient
+struct MaterialData
+{
+    glm::vec3 ambient = glm::vec3(0.0f);
+    float shininess = 32.0f;
+    glm::vec3 diffuse = glm::vec3(0.0f);
+    float padding0 = 0.0f;
+    glm::vec3 specular = glm::vec3(0.0f);
+    float padding1 = 0.0f;
+};
+
+static_assert(sizeof(MaterialData) == 48, "MaterialData must match the std140 Material struct");
+
+// a per-draw material used to be four uniforms on every program that drew it; here each one is written to
+// the shared buffer once, the first time it is seen, and a draw only sets its int materialIndex
+class MaterialTable
+{
+public:
+    static MaterialTable& current()
+    {
+        static MaterialTable table;
+        return table;
+    }
+
+    // index of the material in the block, adding it if it is new
+    int index(const glm::vec3& ambient, const glm::vec3& diffuse, const glm::vec3& specular, float shininess)
+    {
+        MaterialData material;
+        material.ambient = ambient;
+        material.diffuse = diffuse;
+        material.specular = specular;
+        material.shininess = shininess;
+
+        unsigned long long h = hash(material);
+        auto found = lookup.find(h);
+        if (found != lookup.end() && std::memcmp(&materials[found->second], &material, sizeof(MaterialData)) == 0)
+            return found->second;
+        if (found != lookup.end())
+        {
+            // hash collision: fall back to a scan
+            for (size_t i = 0; i < materials.size(); i++)
+                if (std::memcmp(&materials[i], &material, sizeof(MaterialData)) == 0)
+                    return (int)i;
+        }
+
+        if ((int)materials.size() == MAX_MATERIALS)
+        {
+            if (!overflowReported)
+                std::cout << "ERROR::MATERIAL_TABLE::FULL " << MAX_MATERIALS << " materials, drawing with material 0" << std::endl;
+            overflowReported = true;
+            return 0;
+        }
+        if (buffer == 0)
+            buffer = createUniformBuffer(MATERIAL_BINDING, MAX_MATERIALS * sizeof(MaterialData));
+        int added = (int)materials.size();
+        materials.push_back(material);
+        if (found == lookup.end())
+            lookup[h] = added;
+        updateUniformBuffer(buffer, added * sizeof(MaterialData), sizeof(MaterialData), &material);
+        uploadedBytes += sizeof(MaterialData);
+        return added;
+    }
+
+    void release()
+    {
+        if (buffer != 0)
+            glDeleteBuffers(1, &buffer);
+        buffer = 0;
+        materials.clear();
+        lookup.clear();
+    }
+
+    int getMaterialCount() const
+    {
+        return (int)materials.size();
+    }
+    // bytes sent since the last reset; new materials are the only writes
+    void resetStats()
+    {
+        uploadedBytes = 0;
+    }
+    unsigned int getUploadedBytes() const
+    {
+        return uploadedBytes;
+    }
+
+private:
+    MaterialTable() = default;
+
+    // FNV-1a over the std140 bytes
+    static unsigned long long hash(const MaterialData& material)
+    {
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&material);
+        unsigned long long h = 14695981039346656037ull;
+        for (size_t i = 0; i < sizeof(MaterialData); i++)
+        {
+            h ^= bytes[i];
+            h *= 1099511628211ull;
+        }
+        return h;
+    }
+
+    std::vector<MaterialData> materials;        // what the buffer holds, in index order
+    std::unordered_map<unsigned long long, int> lookup;
+    GLuint buffer = 0;
+    bool overflowReported = false;
+    unsigned int uploadedBytes = 0;
+};
+
+#endif /* MATERIAL_TABLE_H */
@@ -0,0 +1,311 @@
+//
+//  meshArena.h
+//  one vertex/index buffer pair and one VAO shared by every parametric mesh
+//
+
+#ifndef MESH_ARENA_H
+#define MESH_ARENA_H
+
+#include <glad/glad.h>
+#include <vector>
+
+// vertex layouts an arena can hold
+enum VertexFormat
+{
+    VERTEX_FLOAT,       // 24 bytes: float position + float normal
+    VERTEX_PACKED       // 12 bytes: unorm16 position relative to the mesh bounds + 2_10_10_10 normal, see vertexPacking.h
+};
+
+// where one mesh lives inside the arena buffers
+struct MeshRange
+{
+    GLint baseVertex = 0;           // added to every index of the mesh
+    unsigned int indexOffset = 0;   // offset into the arena index buffer, in bytes
+    unsigned int indexCount = 0;
+    GLenum indexType = GL_UNSIGNED_INT;     // GL_UNSIGNED_SHORT when the mesh has at most 65536 vertices
+    unsigned int vertexCount = 0;
+};
+
+class MeshArena
+{
+public:
+    // interleaved position + normal, the float layout of Sphere/Cone/Cylinder/Hyperboloid
+    static const int FLOATS_PER_VERTEX = 6;
+    static const int FLOAT_VERTEX_STRIDE = FLOATS_PER_VERTEX * sizeof(float);  // 24 bytes
+    static const int PACKED_VERTEX_STRIDE = 12;
+
+    // the global arena of each vertex format; GL objects are created on the first allocation,
+    // so a context must exist by then
+    static MeshArena& instance(VertexFormat format = VERTEX_FLOAT)
+    {
+        static MeshArena floatArena(VERTEX_FLOAT);
+        static MeshArena packedArena(VERTEX_PACKED);
+        return format == VERTEX_PACKED ? packedArena : floatArena;
+    }
+
+    // copy a float position + normal mesh into a VERTEX_FLOAT arena
+    MeshRange allocate(const std::vector<float>& vertices, const std::vector<unsigned int>& indices)
+    {
+        return allocate(vertices.data(), (unsigned int)vertices.size() / FLOATS_PER_VERTEX, indices);
+    }
+
+    // copy vertexCount vertices already in this arena's format; the returned range stays valid when the arena grows
+    MeshRange allocate(const void* vertexData, unsigned int vertexCount, const std::vector<unsigned int>& indices)
+    {
+        if (arenaVAO == 0)
+            create();
+
+        unsigned int indexCount = (unsigned int)indices.size();
+
+        // indices are relative to baseVertex, so 16 bits are enough for small meshes
+        std::vector<unsigned short> shortIndices;
+        const void* indexData = indices.data();
+        unsigned int indexBytes = indexCount * sizeof(unsigned int);
+        GLenum indexType = GL_UNSIGNED_INT;
+        if (vertexCount <= 65536)
+        {
+            shortIndices.assign(indices.begin(), indices.end());
+            indexData = shortIndices.data();
+            indexBytes = indexCount * sizeof(unsigned short);
+            indexType = GL_UNSIGNED_SHORT;
+        }
+        // keep every block 4 byte aligned so 32 bit index ranges stay aligned too
+        unsigned int blockBytes = (indexBytes + 3) & ~3u;
+
+        // reuse space given back by deallocate() before growing the arena
+        unsigned int firstVertex, indexOffset;
+        bool vertexReused = takeFreeBlock(freeVertexBlocks, vertexCount, firstVertex);
+        bool indexReused = takeFreeBlock(freeIndexBlocks, blockBytes, indexOffset);
+        reserve(usedVertices + (vertexReused ? 0 : vertexCount), usedIndexBytes + (indexReused ? 0 : blockBytes));
+        if (!vertexReused)
+        {
+            firstVertex = usedVertices;
+            usedVertices += vertexCount;
+        }
+        if (!indexReused)
+        {
+            indexOffset = usedIndexBytes;
+            usedIndexBytes += blockBytes;
+        }
+
+        // upload through the copy targets so no VAO's element buffer binding is touched
+        glBindBuffer(GL_COPY_WRITE_BUFFER, arenaVBO);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)firstVertex * vertexStride, (GLsizeiptr)vertexCount * vertexStride, vertexData);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, arenaEBO);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)indexOffset, (GLsizeiptr)indexBytes, indexData);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+        MeshRange range;
+        range.baseVertex = (GLint)firstVertex;
+        range.indexOffset = indexOffset;
+        range.indexCount = indexCount;
+        range.indexType = indexType;
+        range.vertexCount = vertexCount;
+        return range;
+    }
+
+    // give a range back; a later allocation of the same size or smaller reuses it
+    void deallocate(const MeshRange& range)
+    {
+        if (arenaVAO == 0)
+            return;     // already released
+        freeVertexBlocks.push_back(Block{ (unsigned int)range.baseVertex, range.vertexCount });
+        unsigned int indexSize = range.indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+        freeIndexBlocks.push_back(Block{ range.indexOffset, (range.indexCount * indexSize + 3) & ~3u });
+    }
+
+    // every arena mesh uses the same VAO, so switching between primitive types changes no vertex state
+    void bind() const
+    {
+        glBindVertexArray(arenaVAO);
+    }
+
+    void draw(const MeshRange& range) const
+    {
+        bind();
+        glDrawElementsBaseVertex(GL_TRIANGLES, range.indexCount, range.indexType,
+            (void*)(size_t)range.indexOffset, range.baseVertex);
+    }
+
+    // several meshes with the same uniforms (model, material) in one call per index type
+    void multiDraw(const std::vector<MeshRange>& ranges) const
+    {
+        if (ranges.empty())
+            return;
+        bind();
+        const GLenum indexTypes[2] = { GL_UNSIGNED_SHORT, GL_UNSIGNED_INT };
+        std::vector<GLsizei> counts;
+        std::vector<const void*> offsets;
+        std::vector<GLint> baseVertices;
+        for (int type = 0; type < 2; type++)
+        {
+            counts.clear();
+            offsets.clear();
+            baseVertices.clear();
+            for (size_t i = 0; i < ranges.size(); i++)
+            {
+                if (ranges[i].indexType != indexTypes[type])
+                    continue;
+                counts.push_back((GLsizei)ranges[i].indexCount);
+                offsets.push_back((const void*)(size_t)ranges[i].indexOffset);
+                baseVertices.push_back(ranges[i].baseVertex);
+            }
+            if (!counts.empty())
+                glMultiDrawElementsBaseVertex(GL_TRIANGLES, counts.data(), indexTypes[type],
+                    (const void* const*)offsets.data(), (GLsizei)counts.size(), baseVertices.data());
+        }
+    }
+
+    VertexFormat getFormat() const
+    {
+        return format;
+    }
+    int getVertexStride() const
+    {
+        return vertexStride;
+    }
+    unsigned int getVertexCount() const
+    {
+        return usedVertices;
+    }
+    unsigned int getIndexBytes() const
+    {
+        return usedIndexBytes;
+    }
+
+    // free the GL objects; call while the context is still current
+    void release()
+    {
+        if (arenaVAO == 0)
+            return;
+        glDeleteVertexArrays(1, &arenaVAO);
+        glDeleteBuffers(1, &arenaVBO);
+        glDeleteBuffers(1, &arenaEBO);
+        arenaVAO = arenaVBO = arenaEBO = 0;
+        vertexCapacity = indexCapacity = usedVertices = usedIndexBytes = 0;
+        freeVertexBlocks.clear();
+        freeIndexBlocks.clear();
+    }
+
+private:
+    struct Block
+    {
+        unsigned int first;
+        unsigned int count;
+    };
+
+    // first fit; what is left of the block stays on the list
+    static bool takeFreeBlock(std::vector<Block>& blocks, unsigned int count, unsigned int& first)
+    {
+        for (size_t i = 0; i < blocks.size(); i++)
+        {
+            if (blocks[i].count < count)
+                continue;
+            first = blocks[i].first;
+            blocks[i].first += count;
+            blocks[i].count -= count;
+            if (blocks[i].count == 0)
+                blocks.erase(blocks.begin() + i);
+            return true;
+        }
+        return false;
+    }
+
+    MeshArena(VertexFormat format) : format(format),
+        vertexStride(format == VERTEX_PACKED ? PACKED_VERTEX_STRIDE : FLOAT_VERTEX_STRIDE) {}
+    MeshArena(const MeshArena&) = delete;
+    MeshArena& operator=(const MeshArena&) = delete;
+
+    void create()
+    {
+        glGenVertexArrays(1, &arenaVAO);
+        vertexCapacity = 1 << 16;
+        indexCapacity = 1 << 20;
+        arenaVBO = createBuffer((GLsizeiptr)vertexCapacity * vertexStride);
+        arenaEBO = createBuffer((GLsizeiptr)indexCapacity);
+        setupVertexArray();
+    }
+
+    static GLuint createBuffer(GLsizeiptr bytes)
+    {
+        GLuint buffer;
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, bytes, NULL, GL_STATIC_DRAW);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        return buffer;
+    }
+
+    // double the storage until the request fits, keeping what is already there
+    void reserve(unsigned int vertices, unsigned int indexBytes)
+    {
+        bool grown = false;
+        if (vertices > vertexCapacity)
+        {
+            while (vertexCapacity < vertices)
+                vertexCapacity *= 2;
+            growBuffer(arenaVBO, (GLsizeiptr)usedVertices * vertexStride, (GLsizeiptr)vertexCapacity * vertexStride);
+            grown = true;
+        }
+        if (indexBytes > indexCapacity)
+        {
+            while (indexCapacity < indexBytes)
+                indexCapacity *= 2;
+            growBuffer(arenaEBO, (GLsizeiptr)usedIndexBytes, (GLsizeiptr)indexCapacity);
+            grown = true;
+        }
+        if (grown)
+            setupVertexArray();
+    }
+
+    static void growBuffer(GLuint& buffer, GLsizeiptr usedBytes, GLsizeiptr newBytes)
+    {
+        GLuint bigger = createBuffer(newBytes);
+        glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, bigger);
+        if (usedBytes > 0)
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, usedBytes);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        glDeleteBuffers(1, &buffer);
+        buffer = bigger;
+    }
+
+    void setupVertexArray()
+    {
+        glBindVertexArray(arenaVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, arenaVBO);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, arenaEBO);
+
+        glEnableVertexAttribArray(0);
+        glEnableVertexAttribArray(1);
+        if (format == VERTEX_PACKED)
+        {
+            // normalized to [0, 1] / [-1, 1]; the vertex shader applies the mesh bounds
+            glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, vertexStride, (void*)0);
+            glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, vertexStride, (void*)(4 * sizeof(unsigned short)));
+        }
+        else
+        {
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, vertexStride, (void*)0);
+            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, vertexStride, (void*)(3 * sizeof(float)));
+        }
+
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    VertexFormat format;
+    int vertexStride;                   // bytes per vertex
+    GLuint arenaVAO = 0;
+    GLuint arenaVBO = 0;
+    GLuint arenaEBO = 0;
+    unsigned int vertexCapacity = 0;    // in vertices
+    unsigned int indexCapacity = 0;     // in bytes
+    unsigned int usedVertices = 0;
+    unsigned int usedIndexBytes = 0;
+    std::vector<Block> freeVertexBlocks;    // in vertices
+    std::vector<Block> freeIndexBlocks;     // in bytes
+};
+
+#endif /* MESH_ARENA_H */
@@ -0,0 +1,313 @@
+//
+//  meshCache.h
+//  shares one arena mesh between every primitive with the same shape parameters
+//
+
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <map>
+#include <memory>
+#include <tuple>
+#include <vector>
+#include <glm/glm.hpp>
+#include "shader.h"
+#include "meshArena.h"
+#include "meshOptimizer.h"
+#include "meshLod.h"
+#include "bvh.h"
+#include "occlusionCuller.h"
+#include "vertexPacking.h"
+
+enum MeshShape
+{
+    SHAPE_SPHERE,
+    SHAPE_CONE,
+    SHAPE_CYLINDER,
+    SHAPE_HYPERBOLOID
+};
+
+// everything the geometry of a parametric primitive depends on
+// (radius or a/b/c in params, sector/stack or u/v segment counts in counts)
+struct MeshKey
+{
+    MeshShape shape;
+    float params[3];
+    int counts[2];
+    VertexFormat format = VERTEX_FLOAT;     // filled in by the cache
+
+    MeshKey(MeshShape shape, float p0, float p1, float p2, int c0, int c1) : shape(shape)
+    {
+        params[0] = p0;
+        params[1] = p1;
+        params[2] = p2;
+        counts[0] = c0;
+        counts[1] = c1;
+    }
+
+    bool operator<(const MeshKey& other) const
+    {
+        return std::tie(shape, params[0], params[1], params[2], counts[0], counts[1], format) <
+            std::tie(other.shape, other.params[0], other.params[1], other.params[2], other.counts[0], other.counts[1], other.format);
+    }
+};
+
+// geometry only; material stays with the primitive that draws it
+struct ParametricMesh
+{
+    std::vector<float> vertices;            // interleaved position + normal
+    std::vector<unsigned int> indices;
+    VertexFormat format = VERTEX_FLOAT;     // which mesh arena holds it
+    MeshRange range;                        // where it lives in that arena
+    glm::vec3 positionScale = glm::vec3(1.0f);  // dequantization of packed positions
+    glm::vec3 positionBias = glm::vec3(0.0f);
+    glm::vec3 boundsMin = glm::vec3(0.0f);      // bounding box in object space
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+    glm::vec3 boundsCenter = glm::vec3(0.0f);   // bounding sphere in object space
+    float boundsRadius = 0.0f;
+    float acmrBefore = 0.0f;                // vertex cache misses per triangle as generated
+    float acmrAfter = 0.0f;                 // and after optimizeVertexCache
+
+    // the caller has set the material and model uniforms
+    void draw(Shader& shader) const
+    {
+        shader.setVec3(shader.materialUniforms.positionScale, positionScale);
+        shader.setVec3(shader.materialUniforms.positionBias, positionBias);
+        MeshArena::instance(format).draw(range);
+    }
+};
+
+// false when the mesh drawn with model is entirely outside the current frustum or hidden behind an occluder
+inline bool meshVisible(const ParametricMesh& mesh, const glm::mat4& model)
+{
+    return SceneBvh::current().isVisible(model, mesh.boundsMin, mesh.boundsMax)
+        && OcclusionCuller::current().isVisible(model, mesh.boundsMin, mesh.boundsMax);
+}
+
+// the level of lods (MAX_LOD_LEVELS meshes, finest first) that fits the projected size under model
+inline const ParametricMesh& selectLod(const std::shared_ptr<const ParametricMesh>* lods, const glm::mat4& model, LodState* state = nullptr)
+{
+    float pixels = MeshLod::projectedSize(model, lods[0]->boundsCenter, lods[0]->boundsRadius);
+    return *lods[MeshLod::selectLevel(pixels, MAX_LOD_LEVELS, state)];
+}
+
+// copies of one primitive (every LOD level) baked into world space for objects that never move and share a
+// material; the model is the identity for all of them, so the visible copies go out in one
+// glMultiDrawElementsBaseVertex. Copies always live in the float arena, whatever the cache format
+class StaticMeshGroup
+{
+public:
+    // lods are the primitive's MAX_LOD_LEVELS meshes, finest first; they must outlive the group
+    void add(const std::shared_ptr<const ParametricMesh>* lods, const glm::mat4& model)
+    {
+        primitive = lods;
+        Member member;
+        member.model = model;
+        glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(model)));
+        for (int level = 0; level < MAX_LOD_LEVELS; level++)
+        {
+            std::vector<float> world = lods[level]->vertices;
+            for (size_t i = 0; i + MeshArena::FLOATS_PER_VERTEX <= world.size(); i += MeshArena::FLOATS_PER_VERTEX)
+            {
+                glm::vec3 position = glm::vec3(model * glm::vec4(world[i], world[i + 1], world[i + 2], 1.0f));
+                glm::vec3 normal = normalMatrix * glm::vec3(world[i + 3], world[i + 4], world[i + 5]);
+                for (int c = 0; c < 3; c++)
+                {
+                    world[i + c] = position[c];
+                    world[i + 3 + c] = normal[c];
+                }
+            }
+            member.ranges[level] = MeshArena::instance(VERTEX_FLOAT).allocate(world, lods[level]->indices);
+        }
+        members.push_back(member);
+    }
+
+    // culls each copy and picks its level as a separate draw would (states: one per copy, may be null);
+    // the caller has set the material
+    void draw(Shader& shader, LodState* states = nullptr)
+    {
+        visible.clear();
+        for (size_t i = 0; i < members.size(); i++)
+        {
+            const Member& member = members[i];
+            if (!meshVisible(*primitive[0], member.model))
+                continue;
+            float pixels = MeshLod::projectedSize(member.model, primitive[0]->boundsCenter, primitive[0]->boundsRadius);
+            visible.push_back(member.ranges[MeshLod::selectLevel(pixels, MAX_LOD_LEVELS, states ? &states[i] : nullptr)]);
+        }
+        if (visible.empty())
+            return;
+        shader.use();
+        shader.setModel(Affine(glm::mat4(1.0f)));
+        shader.setVec3(shader.materialUniforms.positionScale, glm::vec3(1.0f));
+        shader.setVec3(shader.materialUniforms.positionBias, glm::vec3(0.0f));
+        MeshArena::instance(VERTEX_FLOAT).multiDraw(visible);
+    }
+
+    // hands the baked copies back to the arena
+    void release()
+    {
+        for (const Member& member : members)
+            for (int level = 0; level < MAX_LOD_LEVELS; level++)
+                MeshArena::instance(VERTEX_FLOAT).deallocate(member.ranges[level]);
+        members.clear();
+    }
+
+private:
+    struct Member
+    {
+        glm::mat4 model;                        // object to world, for culling and LOD selection
+        MeshRange ranges[MAX_LOD_LEVELS];       // the baked copy of each level
+    };
+
+    const std::shared_ptr<const ParametricMesh>* primitive = nullptr;
+    std::vector<Member> members;
+    std::vector<MeshRange> visible;
+};
+
+class MeshCache
+{
+public:
+    static MeshCache& instance()
+    {
+        static MeshCache cache;
+        return cache;
+    }
+
+    // return the mesh for key, building and uploading it only if no primitive holds it yet
+    // build(vertices, indices) fills the interleaved vertex and index lists
+    // the arena range is handed back when the last primitive using the mesh goes away
+    template <typename Builder>
+    std::shared_ptr<const ParametricMesh> acquire(MeshKey key, Builder build)
+    {
+        key.format = vertexFormat;
+        std::map<MeshKey, std::weak_ptr<const ParametricMesh> >::iterator it = meshes.find(key);
+        if (it != meshes.end())
+        {
+            std::shared_ptr<const ParametricMesh> shared = it->second.lock();
+            if (shared)
+            {
+                hits++;
+                return shared;
+            }
+        }
+
+        misses++;
+        ParametricMesh* mesh = new ParametricMesh();
+        build(mesh->vertices, mesh->indices);
+        computeBounds(*mesh);
+        optimize(*mesh);
+        mesh->format = vertexFormat;
+        if (vertexFormat == VERTEX_PACKED)
+        {
+            std::vector<PackedVertex> packed;
+            packVertices(mesh->vertices, packed, mesh->positionScale, mesh->positionBias);
+            mesh->range = MeshArena::instance(VERTEX_PACKED).allocate(packed.data(), (unsigned int)packed.size(), mesh->indices);
+        }
+        else
+            mesh->range = MeshArena::instance().allocate(mesh->vertices, mesh->indices);
+
+        std::shared_ptr<const ParametricMesh> shared(mesh, [key](const ParametricMesh* released)
+            {
+                MeshCache::instance().evict(key, released);
+            });
+        meshes[key] = shared;
+        return shared;
+    }
+
+    // layout of meshes built from now on; already built meshes keep theirs
+    void setVertexFormat(VertexFormat format)
+    {
+        vertexFormat = format;
+    }
+    VertexFormat getVertexFormat() const
+    {
+        return vertexFormat;
+    }
+
+    // statistics
+    unsigned int getDistinctMeshes() const
+    {
+        return (unsigned int)meshes.size();
+    }
+    unsigned int getHits() const
+    {
+        return hits;
+    }
+    unsigned int getMisses() const
+    {
+        return misses;
+    }
+    // vertex cache misses per triangle over every mesh built, weighted by triangle count, before and after
+    // optimizeVertexCache
+    float getAcmrBefore() const
+    {
+        return builtTriangles > 0 ? (float)(acmrBeforeSum / builtTriangles) : 0.0f;
+    }
+    float getAcmrAfter() const
+    {
+        return builtTriangles > 0 ? (float)(acmrAfterSum / builtTriangles) : 0.0f;
+    }
+
+private:
+    MeshCache() {}
+    MeshCache(const MeshCache&) = delete;
+    MeshCache& operator=(const MeshCache&) = delete;
+
+    // bounding sphere around the center of the box bounds
+    void computeBounds(ParametricMesh& mesh)
+    {
+        size_t count = mesh.vertices.size() / MeshArena::FLOATS_PER_VERTEX;
+        if (count == 0)
+            return;
+        glm::vec3 minimum(mesh.vertices[0], mesh.vertices[1], mesh.vertices[2]);
+        glm::vec3 maximum = minimum;
+        for (size_t i = 0; i < count; i++)
+        {
+            const float* v = &mesh.vertices[i * MeshArena::FLOATS_PER_VERTEX];
+            minimum = glm::min(minimum, glm::vec3(v[0], v[1], v[2]));
+            maximum = glm::max(maximum, glm::vec3(v[0], v[1], v[2]));
+        }
+        mesh.boundsMin = minimum;
+        mesh.boundsMax = maximum;
+        mesh.boundsCenter = 0.5f * (minimum + maximum);
+        mesh.boundsRadius = 0.0f;
+        for (size_t i = 0; i < count; i++)
+        {
+            const float* v = &mesh.vertices[i * MeshArena::FLOATS_PER_VERTEX];
+            mesh.boundsRadius = glm::max(mesh.boundsRadius, glm::length(glm::vec3(v[0], v[1], v[2]) - mesh.boundsCenter));
+        }
+    }
+
+    // reorder triangles for the post-transform cache, then vertices for fetch locality
+    void optimize(ParametricMesh& mesh)
+    {
+        unsigned int vertexCount = (unsigned int)mesh.vertices.size() / MeshArena::FLOATS_PER_VERTEX;
+        mesh.acmrBefore = computeACMR(mesh.indices, vertexCount);
+        optimizeVertexCache(mesh.indices, vertexCount);
+        optimizeVertexFetch(mesh.vertices, mesh.indices, MeshArena::FLOATS_PER_VERTEX);
+        mesh.acmrAfter = computeACMR(mesh.indices, vertexCount);
+
+        unsigned int triangles = (unsigned int)mesh.indices.size() / 3;
+        builtTriangles += triangles;
+        acmrBeforeSum += mesh.acmrBefore * triangles;
+        acmrAfterSum += mesh.acmrAfter * triangles;
+    }
+
+    void evict(const MeshKey& key, const ParametricMesh* mesh)
+    {
+        meshes.erase(key);
+        MeshArena::instance(mesh->format).deallocate(mesh->range);
+        delete mesh;
+    }
+
+    std::map<MeshKey, std::weak_ptr<const ParametricMesh> > meshes;
+    VertexFormat vertexFormat = VERTEX_FLOAT;
+    unsigned int hits = 0;
+    unsigned int misses = 0;
+    unsigned int builtTriangles = 0;
+    double acmrBeforeSum = 0.0;
+    double acmrAfterSum = 0.0;
+};
+
+#endif /* MESH_CACHE_H */
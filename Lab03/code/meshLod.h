@@ -0,0 +1,114 @@
+//
+//  meshLod.h
+//  picks a tessellation level per draw from the projected size of the mesh
+//
+
+#ifndef MESH_LOD_H
+#define MESH_LOD_H
+
+#include <cmath>
+#include <glm/glm.hpp>
+
+// level 0 is the tessellation the primitive was constructed with, every next level halves the segment counts
+const int MAX_LOD_LEVELS = 3;
+
+// smallest projected diameter, in pixels, at which levels 0 and 1 are still used
+const float LOD_PIXEL_THRESHOLDS[MAX_LOD_LEVELS - 1] = { 240.0f, 80.0f };
+
+// a level only changes once the size is this far past the threshold, so objects near it do not pop
+const float LOD_HYSTERESIS = 0.2f;
+
+// remembers the level of one draw site between frames
+struct LodState
+{
+    int level = -1;
+};
+
+class MeshLod
+{
+public:
+    // camera of the current frame; call once per frame before drawing
+    static void setView(const glm::mat4& view, const glm::mat4& projection, float viewportHeight)
+    {
+        // view is rigid, so the eye is -R^T * t
+        glm::mat3 rotation(view);
+        eye() = -(glm::transpose(rotation) * glm::vec3(view[3]));
+        // projection[1][1] maps a unit at distance 1 to half the viewport height in NDC
+        pixelsPerUnit() = 0.5f * viewportHeight * projection[1][1];
+    }
+
+    // false forces level 0 everywhere
+    static bool& enabled()
+    {
+        static bool on = true;
+        return on;
+    }
+
+    // projected diameter in pixels of the bounding sphere (center, radius) of a mesh drawn with model
+    static float projectedSize(const glm::mat4& model, const glm::vec3& center, float radius)
+    {
+        glm::vec3 worldCenter = glm::vec3(model * glm::vec4(center, 1.0f));
+        float scale = glm::max(glm::length(glm::vec3(model[0])), glm::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+        float distance = glm::length(worldCenter - eye());
+        float worldRadius = radius * scale;
+        if (distance <= worldRadius)
+            return 1.0e9f;     // the camera is inside the bounds
+        return 2.0f * worldRadius * pixelsPerUnit() / distance;
+    }
+
+    // level for a projected size; with a state the level only moves once the size clears the hysteresis band
+    static int selectLevel(float pixels, int levelCount, LodState* state = nullptr)
+    {
+        int level = 0;
+        if (enabled())
+        {
+            if (state == nullptr || state->level < 0 || state->level >= levelCount)
+            {
+                while (level < levelCount - 1 && pixels < LOD_PIXEL_THRESHOLDS[level])
+                    level++;
+            }
+            else
+            {
+                level = state->level;
+                while (level > 0 && pixels >= LOD_PIXEL_THRESHOLDS[level - 1] * (1.0f + LOD_HYSTERESIS))
+                    level--;
+                while (level < levelCount - 1 && pixels < LOD_PIXEL_THRESHOLDS[level] * (1.0f - LOD_HYSTERESIS))
+                    level++;
+            }
+        }
+        if (state != nullptr)
+            state->level = level;
+        drawsPerLevel()[level]++;
+        return level;
+    }
+
+    // per-frame statistics
+    static void resetStats()
+    {
+        for (int i = 0; i < MAX_LOD_LEVELS; i++)
+            drawsPerLevel()[i] = 0;
+    }
+    static unsigned int getDraws(int level)
+    {
+        return drawsPerLevel()[level];
+    }
+
+private:
+    static glm::vec3& eye()
+    {
+        static glm::vec3 position(0.0f);
+        return position;
+    }
+    static float& pixelsPerUnit()
+    {
+        static float pixels = 1.0f;
+        return pixels;
+    }
+    static unsigned int* drawsPerLevel()
+    {
+        static unsigned int draws[MAX_LOD_LEVELS] = { 0 };
+        return draws;
+    }
+};
+
+#endif /* MESH_LOD_H */
@@ -0,0 +1,154 @@
+//
+//  meshOptimizer.h
+//  post-transform vertex cache (Tipsify) and vertex fetch reordering of generated meshes
+//
+
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <vector>
+
+// size of the FIFO cache the optimizer targets and the ACMR is measured with
+const int VERTEX_CACHE_SIZE = 16;
+
+// average cache miss ratio: vertex shader invocations per triangle through a FIFO cache
+// (3.0 means nothing is reused, about 0.5 is the best a regular grid can do)
+inline float computeACMR(const std::vector<unsigned int>& indices, unsigned int vertexCount, int cacheSize = VERTEX_CACHE_SIZE)
+{
+    if (indices.size() < 3)
+        return 0.0f;
+
+    // a vertex is in the cache while fewer than cacheSize misses happened since it was loaded
+    std::vector<unsigned int> loadedAt(vertexCount, 0);
+    std::vector<bool> everLoaded(vertexCount, false);
+    unsigned int misses = 0;
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        unsigned int v = indices[i];
+        if (!everLoaded[v] || misses - loadedAt[v] >= (unsigned int)cacheSize)
+        {
+            everLoaded[v] = true;
+            loadedAt[v] = misses;
+            misses++;
+        }
+    }
+    return (float)misses / (float)(indices.size() / 3);
+}
+
+// Tipsify (Sander, Nehab and Barczak 2007): fan around the most recently used vertex that
+// still has triangles left, so the emitted order stays inside a cacheSize FIFO
+inline void optimizeVertexCache(std::vector<unsigned int>& indices, unsigned int vertexCount, int cacheSize = VERTEX_CACHE_SIZE)
+{
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+        return;
+
+    // triangles around every vertex, compressed into one list
+    std::vector<unsigned int> liveTriangles(vertexCount, 0);
+    for (size_t i = 0; i < triangleCount * 3; i++)
+        liveTriangles[indices[i]]++;
+    std::vector<unsigned int> adjacencyOffset(vertexCount + 1, 0);
+    for (unsigned int v = 0; v < vertexCount; v++)
+        adjacencyOffset[v + 1] = adjacencyOffset[v] + liveTriangles[v];
+    std::vector<unsigned int> adjacency(adjacencyOffset[vertexCount]);
+    std::vector<unsigned int> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+    for (size_t t = 0; t < triangleCount; t++)
+        for (int corner = 0; corner < 3; corner++)
+            adjacency[fill[indices[t * 3 + corner]]++] = (unsigned int)t;
+
+    std::vector<int> cacheTime(vertexCount, 0);
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<unsigned int> deadEnd;
+    std::vector<unsigned int> candidates;
+    std::vector<unsigned int> output;
+    output.reserve(triangleCount * 3);
+    int timestamp = cacheSize + 1;
+    unsigned int cursor = 0;
+    int fanning = 0;
+
+    while (fanning >= 0)
+    {
+        candidates.clear();
+        for (unsigned int a = adjacencyOffset[fanning]; a < adjacencyOffset[fanning + 1]; a++)
+        {
+            unsigned int t = adjacency[a];
+            if (emitted[t])
+                continue;
+            for (int corner = 0; corner < 3; corner++)
+            {
+                unsigned int v = indices[t * 3 + corner];
+                output.push_back(v);
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                liveTriangles[v]--;
+                if (timestamp - cacheTime[v] > cacheSize)
+                    cacheTime[v] = timestamp++;
+            }
+            emitted[t] = true;
+        }
+
+        // next fanning vertex: the oldest candidate that will still be cached after its fan
+        int next = -1;
+        int bestPriority = -1;
+        for (size_t c = 0; c < candidates.size(); c++)
+        {
+            unsigned int v = candidates[c];
+            if (liveTriangles[v] == 0)
+                continue;
+            int priority = 0;
+            if (timestamp - cacheTime[v] + 2 * (int)liveTriangles[v] <= cacheSize)
+                priority = timestamp - cacheTime[v];
+            if (priority > bestPriority)
+            {
+                bestPriority = priority;
+                next = (int)v;
+            }
+        }
+
+        // dead end: back up through recently emitted vertices, then scan the rest in order
+        while (next < 0 && !deadEnd.empty())
+        {
+            unsigned int v = deadEnd.back();
+            deadEnd.pop_back();
+            if (liveTriangles[v] > 0)
+                next = (int)v;
+        }
+        while (next < 0 && cursor < vertexCount)
+        {
+            if (liveTriangles[cursor] > 0)
+                next = (int)cursor;
+            cursor++;
+        }
+        fanning = next;
+    }
+
+    indices.swap(output);
+}
+
+// renumber vertices in the order the indices first use them, so fetches walk the buffer forward
+// vertices holds vertexCount interleaved vertices of floatsPerVertex floats; unreferenced ones move to the end
+inline void optimizeVertexFetch(std::vector<float>& vertices, std::vector<unsigned int>& indices, int floatsPerVertex)
+{
+    unsigned int vertexCount = (unsigned int)(vertices.size() / floatsPerVertex);
+    const unsigned int UNUSED = 0xFFFFFFFFu;
+    std::vector<unsigned int> remap(vertexCount, UNUSED);
+    unsigned int nextVertex = 0;
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        unsigned int& target = remap[indices[i]];
+        if (target == UNUSED)
+            target = nextVertex++;
+        indices[i] = target;
+    }
+    for (unsigned int v = 0; v < vertexCount; v++)
+        if (remap[v] == UNUSED)
+            remap[v] = nextVertex++;
+
+    std::vector<float> reordered(vertices.size());
+    for (unsigned int v = 0; v < vertexCount; v++)
+        for (int f = 0; f < floatsPerVertex; f++)
+            reordered[remap[v] * floatsPerVertex + f] = vertices[v * floatsPerVertex + f];
+    vertices.swap(reordered);
+}
+
+#endif /* MESH_OPTIMIZER_H */
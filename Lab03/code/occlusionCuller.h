@@ -0,0 +1,313 @@
+//
+//  occlusionCuller.h
+//  software depth buffer of a few large occluders for skipping objects hidden behind them
+//
+
+#ifndef OCCLUSION_CULLER_H
+#define OCCLUSION_CULLER_H
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <glm/glm.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define OCCLUSION_SSE 1
+#endif
+
+// pure CPU, no GL calls: occluders are boxes rasterized into a small NDC depth buffer, objects are
+// tested with their screen rectangle and nearest depth. Occluders are written conservatively (whole pixels
+// only, farthest depth), so a buffer pixel never claims to block anything the real occluder does not.
+// Fills and tests run four pixels at a time
+class OcclusionCuller
+{
+public:
+    // low resolution keeps rasterization cheap; width must stay a multiple of 4 for the SIMD rows
+    static const int WIDTH = 128;
+    static const int HEIGHT = 96;
+    // NDC depth slack so an occluder facing the camera never hides itself through rounding
+    static constexpr float DEPTH_BIAS = 1.0e-5f;
+    // a box face clipped by the near plane has at most one vertex more than its quad
+    static const int MAX_POLYGON = 5;
+
+    static OcclusionCuller& current()
+    {
+        static OcclusionCuller culler;
+        return culler;
+    }
+
+    OcclusionCuller() : depth(WIDTH * HEIGHT, 1.0f)
+    {
+    }
+
+    // clears the buffer for a new frame seen through projectionView
+    void begin(const glm::mat4& projectionView)
+    {
+        transform = projectionView;
+        std::fill(depth.begin(), depth.end(), 1.0f);
+        occluders = 0;
+        tested = 0;
+        occluded = 0;
+    }
+
+    // object space box drawn with model; its 6 faces go into the depth buffer
+    void addOccluder(const glm::mat4& model, const glm::vec3& boxMin, const glm::vec3& boxMax)
+    {
+        if (!enabled)
+            return;
+        // corner i has bit 2 = x max, bit 1 = y max, bit 0 = z max; each face goes around its quad
+        static const int FACES[6][4] = {
+            { 0, 1, 3, 2 }, { 4, 6, 7, 5 },     // x min, x max
+            { 0, 4, 5, 1 }, { 2, 3, 7, 6 },     // y min, y max
+            { 0, 2, 6, 4 }, { 1, 5, 7, 3 }      // z min, z max
+        };
+        glm::vec4 corners[8];
+        boxCorners(model, boxMin, boxMax, corners);
+        for (int i = 0; i < 6; i++)
+        {
+            glm::vec4 face[4] = { corners[FACES[i][0]], corners[FACES[i][1]], corners[FACES[i][2]], corners[FACES[i][3]] };
+            rasterizeClipped(face);
+        }
+        occluders++;
+    }
+
+    // false only when every pixel under the box's screen rectangle holds an occluder nearer than the box
+    bool isVisible(const glm::mat4& model, const glm::vec3& boxMin, const glm::vec3& boxMax)
+    {
+        if (!enabled || occluders == 0)
+            return true;
+        tested++;
+
+        glm::vec4 corners[8];
+        boxCorners(model, boxMin, boxMax, corners);
+        glm::vec2 low(1.0e30f), high(-1.0e30f);
+        float nearest = 1.0e30f;
+        for (int i = 0; i < 8; i++)
+        {
+            // a box reaching behind the near plane covers the camera; never hide it
+            if (corners[i].z < -corners[i].w || corners[i].w <= 0.0f)
+                return true;
+            glm::vec3 ndc = glm::vec3(corners[i]) / corners[i].w;
+            glm::vec2 screen = toScreen(ndc);
+            low = glm::min(low, screen);
+            high = glm::max(high, screen);
+            nearest = std::min(nearest, ndc.z);
+        }
+
+        int x0 = std::max(0, (int)std::floor(low.x));
+        int x1 = std::min(WIDTH - 1, (int)std::ceil(high.x) - 1);
+        int y0 = std::max(0, (int)std::floor(low.y));
+        int y1 = std::min(HEIGHT - 1, (int)std::ceil(high.y) - 1);
+        if (x0 > x1 || y0 > y1)
+            return true;    // off screen; the frustum test owns that case
+
+        bool hidden = rectangleHidden(x0, y0, x1, y1, nearest - DEPTH_BIAS);
+        if (hidden)
+            occluded++;
+        return !hidden;
+    }
+
+    // per-frame statistics
+    unsigned int getOccluders() const
+    {
+        return occluders;
+    }
+    unsigned int getTested() const
+    {
+        return tested;
+    }
+    unsigned int getOccluded() const
+    {
+        return occluded;
+    }
+    const std::vector<float>& getDepth() const
+    {
+        return depth;
+    }
+
+    bool enabled = true;
+
+private:
+    void boxCorners(const glm::mat4& model, const glm::vec3& boxMin, const glm::vec3& boxMax, glm::vec4 corners[8]) const
+    {
+        glm::mat4 toClip = transform * model;
+        for (int i = 0; i < 8; i++)
+        {
+            glm::vec3 corner((i & 4) ? boxMax.x : boxMin.x, (i & 2) ? boxMax.y : boxMin.y, (i & 1) ? boxMax.z : boxMin.z);
+            corners[i] = toClip * glm::vec4(corner, 1.0f);
+        }
+    }
+
+    static glm::vec2 toScreen(const glm::vec3& ndc)
+    {
+        return glm::vec2((ndc.x * 0.5f + 0.5f) * WIDTH, (ndc.y * 0.5f + 0.5f) * HEIGHT);
+    }
+
+    // clips a face against the near plane (z >= -w); what is left is a convex polygon of up to 5 vertices
+    void rasterizeClipped(const glm::vec4 face[4])
+    {
+        glm::vec4 polygon[MAX_POLYGON];
+        int count = 0;
+        for (int i = 0; i < 4; i++)
+        {
+            const glm::vec4& a = face[i];
+            const glm::vec4& b = face[(i + 1) % 4];
+            float da = a.z + a.w;
+            float db = b.z + b.w;
+            if (da >= 0.0f)
+                polygon[count++] = a;
+            if ((da >= 0.0f) != (db >= 0.0f))
+                polygon[count++] = a + (b - a) * (da / (da - db));
+        }
+        if (count < 3)
+            return;
+        glm::vec3 screen[MAX_POLYGON];
+        for (int v = 0; v < count; v++)
+        {
+            if (polygon[v].w <= 0.0f)
+                return;
+            glm::vec3 ndc = glm::vec3(polygon[v]) / polygon[v].w;
+            screen[v] = glm::vec3(toScreen(ndc), ndc.z);
+        }
+        rasterize(screen, count);
+    }
+
+    // convex screen space polygon (x, y in pixels, z in NDC), drawn conservatively: only pixels the polygon
+    // covers entirely are written, with the farthest depth it reaches over the pixel. A whole face goes in
+    // at once, so no pixel is lost along the diagonal a split into triangles would leave
+    void rasterize(glm::vec3 v[], int count)
+    {
+        float area = 0.0f;
+        for (int i = 0; i < count; i++)
+        {
+            const glm::vec3& p = v[i];
+            const glm::vec3& q = v[(i + 1) % count];
+            area += p.x * q.y - q.x * p.y;
+        }
+        if (std::fabs(area) < 1.0e-6f)
+            return;     // seen edge on
+        if (area < 0.0f)
+            std::reverse(v, v + count);
+
+        float left = 1.0e30f, right = -1.0e30f, bottom = 1.0e30f, top = -1.0e30f;
+        for (int i = 0; i < count; i++)
+        {
+            left = std::min(left, v[i].x);
+            right = std::max(right, v[i].x);
+            bottom = std::min(bottom, v[i].y);
+            top = std::max(top, v[i].y);
+        }
+        int x0 = std::max(0, (int)std::floor(left));
+        int x1 = std::min(WIDTH - 1, (int)std::ceil(right) - 1);
+        int y0 = std::max(0, (int)std::floor(bottom));
+        int y1 = std::min(HEIGHT - 1, (int)std::ceil(top) - 1);
+        if (x0 > x1 || y0 > y1)
+            return;
+        x0 &= ~3;   // whole groups of four
+
+        // edge i runs from vertex i to i + 1: e(x, y) = a * x + b * y + c, positive inside. Evaluated at the
+        // pixel center, c is pulled in by the most e changes toward a corner, so e >= 0 means all four corners
+        // are inside
+        float a[MAX_POLYGON], b[MAX_POLYGON], c[MAX_POLYGON];
+        for (int i = 0; i < count; i++)
+        {
+            const glm::vec3& p = v[i];
+            const glm::vec3& q = v[(i + 1) % count];
+            a[i] = p.y - q.y;
+            b[i] = q.x - p.x;
+            c[i] = p.x * q.y - p.y * q.x - 0.5f * (std::fabs(a[i]) + std::fabs(b[i]));
+        }
+        // the face is planar, so NDC depth is a plane over the screen; taken from the three vertices spanning
+        // the most area and moved to the farthest corner of each pixel
+        int i1 = 1, i2 = 2;
+        float best = 0.0f;
+        for (int j = 1; j + 1 < count; j++)
+            for (int k = j + 1; k < count; k++)
+            {
+                float spanned = std::fabs((v[j].x - v[0].x) * (v[k].y - v[0].y) - (v[j].y - v[0].y) * (v[k].x - v[0].x));
+                if (spanned > best)
+                {
+                    best = spanned;
+                    i1 = j;
+                    i2 = k;
+                }
+            }
+        glm::vec3 e1 = v[i1] - v[0];
+        glm::vec3 e2 = v[i2] - v[0];
+        float determinant = e1.x * e2.y - e1.y * e2.x;
+        if (std::fabs(determinant) < 1.0e-6f)
+            return;
+        float zx = (e1.z * e2.y - e2.z * e1.y) / determinant;
+        float zy = (e2.z * e1.x - e1.z * e2.x) / determinant;
+        float zc = v[0].z - zx * v[0].x - zy * v[0].y + 0.5f * (std::fabs(zx) + std::fabs(zy));
+
+        for (int y = y0; y <= y1; y++)
+        {
+            float py = y + 0.5f;
+            float* row = &depth[y * WIDTH];
+#ifdef OCCLUSION_SSE
+            __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+            __m128 zero = _mm_setzero_ps();
+            for (int x = x0; x <= x1; x += 4)
+            {
+                __m128 px = _mm_add_ps(_mm_set1_ps((float)x), offsets);
+                __m128 inside = _mm_cmpge_ps(edge(a[0], b[0], c[0], px, py), zero);
+                for (int i = 1; i < count; i++)
+                    inside = _mm_and_ps(inside, _mm_cmpge_ps(edge(a[i], b[i], c[i], px, py), zero));
+                if (_mm_movemask_ps(inside) == 0)
+                    continue;
+                __m128 z = edge(zx, zy, zc, px, py);
+                __m128 stored = _mm_loadu_ps(row + x);
+                __m128 nearer = _mm_min_ps(stored, z);
+                _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, stored)));
+            }
+#else
+            for (int x = x0; x <= x1; x++)
+            {
+                float px = x + 0.5f;
+                bool inside = true;
+                for (int i = 0; i < count && inside; i++)
+                    inside = a[i] * px + b[i] * py + c[i] >= 0.0f;
+                if (inside)
+                    row[x] = std::min(row[x], zx * px + zy * py + zc);
+            }
+#endif
+        }
+    }
+
+#ifdef OCCLUSION_SSE
+    static __m128 edge(float a, float b, float c, __m128 px, float py)
+    {
+        return _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a), px), _mm_set1_ps(b * py + c));
+    }
+#endif
+
+    // true when no pixel of the rectangle is at or behind depth nearest
+    bool rectangleHidden(int x0, int y0, int x1, int y1, float nearest) const
+    {
+        for (int y = y0; y <= y1; y++)
+        {
+            const float* row = &depth[y * WIDTH];
+            int x = x0;
+#ifdef OCCLUSION_SSE
+            __m128 limit = _mm_set1_ps(nearest);
+            for (; x + 3 <= x1; x += 4)
+                if (_mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(row + x), limit)) != 0)
+                    return false;
+#endif
+            for (; x <= x1; x++)
+                if (row[x] >= nearest)
+                    return false;
+        }
+        return true;
+    }
+
+    glm::mat4 transform = glm::mat4(1.0f);  // projection * view of the frame
+    std::vector<float> depth;               // NDC z per pixel, row major from the bottom, 1 is empty
+    unsigned int occluders = 0;
+    unsigned int tested = 0;
+    unsigned int occluded = 0;
+};
+
+#endif /* OCCLUSION_CULLER_H */
@@ -0,0 +1,138 @@
+//
+//  occlusionQuery.h
+//  hardware occlusion queries on bounding boxes with conditional rendering of the real object
+//
+
+#ifndef OCCLUSION_QUERY_H
+#define OCCLUSION_QUERY_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include "shader.h"
+#include "bvh.h"
+
+// the two queries of one draw site, used in turns: one is being answered by the GPU while the
+// other is issued, so this frame's draw is conditional on last frame's box query
+struct OcclusionQueryState
+{
+    unsigned int queries[2] = { 0, 0 };
+    bool issued[2] = { false, false };
+    int current = 0;
+};
+
+class OcclusionQueries
+{
+public:
+    // boxVAO holds the (0..1) cube with positions at location 0; boxShader only needs model/view/projection
+    OcclusionQueries(unsigned int boxVAO, Shader& boxShader) : boxVAO(boxVAO), boxShader(boxShader)
+    {
+    }
+
+    // camera of the frame; boxShader's view and projection must already be set
+    void beginFrame(const glm::mat4& view)
+    {
+        glm::mat3 rotation(view);
+        eye = -(glm::transpose(rotation) * glm::vec3(view[3]));
+        queried = 0;
+        hidden = 0;
+    }
+
+    // queries the object space box (boxMin, boxMax) under model, then starts conditional rendering on the
+    // result from the previous frame. Returns true when endConditional must follow the object's draw
+    bool beginConditional(OcclusionQueryState& state, const glm::mat4& model, const glm::vec3& boxMin, const glm::vec3& boxMax)
+    {
+        if (!enabled)
+            return false;
+        if (state.queries[0] == 0)
+            glGenQueries(2, state.queries);
+
+        int current = state.current;
+        int previous = 1 - current;
+        state.current = previous;
+
+        // the query issued two frames ago in this slot: count it if the GPU is done, never wait for it
+        if (state.issued[current])
+        {
+            GLint available = 0;
+            glGetQueryObjectiv(state.queries[current], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available)
+            {
+                GLint samples = 0;
+                glGetQueryObjectiv(state.queries[current], GL_QUERY_RESULT, &samples);
+                queried++;
+                if (samples == 0)
+                    hidden++;
+            }
+        }
+
+        // with the eye inside the box its faces are clipped away and the query would hide the object
+        glm::mat4 boxModel = model * glm::translate(glm::mat4(1.0f), boxMin) * glm::scale(glm::mat4(1.0f), boxMax - boxMin);
+        state.issued[current] = !containsEye(boxModel);
+        if (state.issued[current])
+        {
+            // depth tested against what is already drawn, but leaves color and depth untouched
+            glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+            glDepthMask(GL_FALSE);
+            boxShader.use();
+            boxShader.setMat4(boxShader.materialUniforms.model, boxModel);
+            glBindVertexArray(boxVAO);
+            glBeginQuery(GL_ANY_SAMPLES_PASSED, state.queries[current]);
+            glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+            glEndQuery(GL_ANY_SAMPLES_PASSED);
+            glDepthMask(GL_TRUE);
+            glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        }
+
+        if (!state.issued[previous])
+            return false;
+        // NO_WAIT draws normally while the result is still in flight, so the pipeline never stalls
+        glBeginConditionalRender(state.queries[previous], GL_QUERY_NO_WAIT);
+        return true;
+    }
+
+    void endConditional(bool active)
+    {
+        if (active)
+            glEndConditionalRender();
+    }
+
+    void release(OcclusionQueryState& state)
+    {
+        if (state.queries[0] != 0)
+            glDeleteQueries(2, state.queries);
+        state = OcclusionQueryState();
+    }
+
+    // per-frame statistics from results that were already available
+    unsigned int getQueried() const
+    {
+        return queried;
+    }
+    unsigned int getHidden() const
+    {
+        return hidden;
+    }
+
+    bool enabled = true;
+
+private:
+    // distance from the eye to the near plane corners of the kitchen projection, with some slack
+    static constexpr float NEAR_MARGIN = 0.25f;
+
+    // eye inside the world box of the (0..1) cube under boxModel, widened by the reach of the near plane
+    bool containsEye(const glm::mat4& boxModel) const
+    {
+        BvhBox box = SceneBvh::worldBox(boxModel, glm::vec3(0.0f), glm::vec3(1.0f));
+        glm::vec3 margin(NEAR_MARGIN);
+        return glm::all(glm::greaterThan(eye, box.min - margin)) && glm::all(glm::lessThan(eye, box.max + margin));
+    }
+
+    unsigned int boxVAO;
+    Shader& boxShader;
+    glm::vec3 eye = glm::vec3(0.0f);
+    unsigned int queried = 0;
+    unsigned int hidden = 0;
+};
+
+#endif /* OCCLUSION_QUERY_H */
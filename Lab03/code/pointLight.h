@@ -11,6 +11,7 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 #include "shader.h"
+#include "lightManager.h"
 
 class PointLight {
 public:
@@ -34,62 +35,31 @@ public:
         k_q = quadratic;
         lightNumber = num;
     }
-    void setUpPointLight(Shader& lightingShader)
+    // copies the light, with its term factors applied, into its LightManager slot; a light that is off
+    // keeps its slot but is left out of the packed buffer, so no fragment evaluates it
+    void setUpPointLight(LightManager& lights)
     {
-        lightingShader.use();
-
-        if (lightNumber == 1) {
-            lightingShader.setVec3("pointLights[0].position", position);
-            lightingShader.setVec3("pointLights[0].ambient", ambientOn * ambient);
-            lightingShader.setVec3("pointLights[0].diffuse", diffuseOn * diffuse);
-            lightingShader.setVec3("pointLights[0].specular", specularOn * specular);
-            lightingShader.setFloat("pointLights[0].k_c", k_c);
-            lightingShader.setFloat("pointLights[0].k_l", k_l);
-            lightingShader.setFloat("pointLights[0].k_q", k_q);
-        }
-
+        PointLightData light;
+        light.position = position;
+        light.ambient = ambientOn * ambient;
+        light.diffuse = diffuseOn * diffuse;
+        light.specular = specularOn * specular;
+        light.k_c = k_c;
+        light.k_l = k_l;
+        light.k_q = k_q;
+        if (slot < 0)
+            slot = lights.addPointLight(light);
         else
-        {
-            lightingShader.setVec3("pointLights[1].position", position);
-            lightingShader.setVec3("pointLights[1].ambient", ambientOn * ambient);
-            lightingShader.setVec3("pointLights[1].diffuse", diffuseOn * diffuse);
-            lightingShader.setVec3("pointLights[1].specular", specularOn * specular);
-            lightingShader.setFloat("pointLights[1].k_c", k_c);
-            lightingShader.setFloat("pointLights[1].k_l", k_l);
-            lightingShader.setFloat("pointLights[1].k_q", k_q);
-        }
-        //else if (lightNumber == 3)
-        //{
-        //    lightingShader.setVec3("pointLights[2].position", position);
-        //    lightingShader.setVec3("pointLights[2].ambient", ambientOn * ambient);
-        //    lightingShader.setVec3("pointLights[2].diffuse", diffuseOn * diffuse);
-        //    lightingShader.setVec3("pointLights[2].specular", specularOn * specular);
-        //    lightingShader.setFloat("pointLights[2].k_c", k_c);
-        //    lightingShader.setFloat("pointLights[2].k_l", k_l);
-        //    lightingShader.setFloat("pointLights[2].k_q", k_q);
-        //}
-        //else
-        //{
-        //    lightingShader.setVec3("pointLights[3].position", position);
-        //    lightingShader.setVec3("pointLights[3].ambient", ambientOn * ambient);
-        //    lightingShader.setVec3("pointLights[3].diffuse", diffuseOn * diffuse);
-        //    lightingShader.setVec3("pointLights[3].specular", specularOn * specular);
-        //    lightingShader.setFloat("pointLights[3].k_c", k_c);
-        //    lightingShader.setFloat("pointLights[3].k_l", k_l);
-        //    lightingShader.setFloat("pointLights[3].k_q", k_q);
-        //}
+            lights.setPointLight(slot, light);
+        lights.setPointLightEnabled(slot, enabled);
     }
     void turnOff()
     {
-        ambientOn = 0.0;
-        diffuseOn = 0.0;
-        specularOn = 0.0;
+        enabled = false;
     }
     void turnOn()
     {
-        ambientOn = 1.0;
-        diffuseOn = 1.0;
-        specularOn = 1.0;
+        enabled = true;
     }
     void turnAmbientOn()
     {
@@ -119,6 +89,8 @@ private:
     float ambientOn = 1.0;
     float diffuseOn = 1.0;
     float specularOn = 1.0;
+    bool enabled = true;
+    int slot = -1;      // index in the LightManager, assigned on the first setUpPointLight
 };
 
 #endif /* pointLight_h */
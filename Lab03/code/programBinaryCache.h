@@ -0,0 +1,252 @@
+//
+//  programBinaryCache.h
+//  linked program binaries kept on disk between runs, so a known shader is loaded instead of compiled
+//
+
+#ifndef PROGRAM_BINARY_CACHE_H
+#define PROGRAM_BINARY_CACHE_H
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <glad/glad.h>
+#include "shaderCompiler.h"
+
+// the loader is generated for plain GL 3.3, so the ARB_get_program_binary entry points are fetched here
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+typedef void (APIENTRYP ProgramBinaryGetProc)(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary);
+typedef void (APIENTRYP ProgramBinaryLoadProc)(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+typedef void (APIENTRYP ProgramParameterProc)(GLuint program, GLenum pname, GLint value);
+
+// one file holds every program: a header with the hash of the driver strings, then (key, format, size,
+// binary) entries keyed by a hash of the final sources, defines included. A different driver discards the
+// whole file; a binary the driver refuses falls back to compiling. Only programs used this run are saved
+class ProgramBinaryCache
+{
+public:
+    static ProgramBinaryCache& current()
+    {
+        static ProgramBinaryCache cache;
+        return cache;
+    }
+
+    // after the context is current; without ARB_get_program_binary (or GL 4.1) every program is compiled
+    void init(GLADloadproc loader, const std::string& cachePath)
+    {
+        path = cachePath;
+        if (!hasGLExtension("GL_ARB_get_program_binary") && !(GLVersion.major > 4 || (GLVersion.major == 4 && GLVersion.minor >= 1)))
+            return;
+        getProgramBinary = (ProgramBinaryGetProc)loader("glGetProgramBinary");
+        programBinary = (ProgramBinaryLoadProc)loader("glProgramBinary");
+        programParameteri = (ProgramParameterProc)loader("glProgramParameteri");
+        GLint formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        available = getProgramBinary != nullptr && programBinary != nullptr && programParameteri != nullptr && formats > 0;
+        if (!available)
+            return;
+
+        std::string driver;
+        const char* strings[3] = { (const char*)glGetString(GL_VENDOR), (const char*)glGetString(GL_RENDERER), (const char*)glGetString(GL_VERSION) };
+        for (int i = 0; i < 3; i++)
+            driver += std::string(strings[i] ? strings[i] : "") + "\n";
+        driverHash = hash(0, driver);
+        readFile();
+    }
+
+    bool isAvailable() const
+    {
+        return available;
+    }
+
+    // identifies a program by its sources exactly as they are compiled
+    unsigned long long key(const std::string& vertexCode, const std::string& fragmentCode, const std::string& geometryCode) const
+    {
+        unsigned long long h = hash(0, vertexCode);
+        h = hash(h ^ 0x9e3779b97f4a7c15ull, fragmentCode);
+        return hash(h ^ 0x9e3779b97f4a7c15ull, geometryCode);
+    }
+
+    // links program from the cached binary; false (and the program left unlinked) if it has to be compiled
+    bool load(GLuint program, unsigned long long programKey)
+    {
+        auto found = entries.find(programKey);
+        if (!available || found == entries.end())
+        {
+            misses++;
+            return false;
+        }
+        programBinary(program, found->second.format, found->second.binary.data(), (GLsizei)found->second.binary.size());
+        GLint success = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        if (!success)
+        {
+            // the driver changed its mind (e.g. an update with the same version string)
+            entries.erase(found);
+            misses++;
+            return false;
+        }
+        found->second.used = true;
+        hits++;
+        return true;
+    }
+
+    // before glLinkProgram of a program that will be stored
+    void prepare(GLuint program) const
+    {
+        if (available)
+            programParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
+    // keeps the linked program's binary for save()
+    void store(GLuint program, unsigned long long programKey)
+    {
+        if (!available)
+            return;
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0)
+            return;
+        Entry entry;
+        entry.binary.resize(length);
+        GLsizei written = 0;
+        getProgramBinary(program, length, &written, &entry.format, entry.binary.data());
+        entry.binary.resize(written);
+        entry.used = true;
+        entries[programKey] = entry;
+        dirty = true;
+    }
+
+    // writes the file if a program was added or dropped; at exit, needs no GL context
+    void save()
+    {
+        if (!available)
+            return;
+        for (const auto& entry : entries)
+            if (!entry.second.used)
+                dirty = true;
+        if (!dirty)
+            return;
+
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        if (!file)
+        {
+            std::cout << "ERROR::PROGRAM_BINARY_CACHE::CANNOT_WRITE " << path << std::endl;
+            return;
+        }
+        unsigned int count = 0;
+        for (const auto& entry : entries)
+            if (entry.second.used)
+                count++;
+        unsigned int magic = MAGIC;
+        writeValue(file, magic);
+        writeValue(file, driverHash);
+        writeValue(file, count);
+        for (const auto& entry : entries)
+        {
+            if (!entry.second.used)
+                continue;
+            unsigned int size = (unsigned int)entry.second.binary.size();
+            writeValue(file, entry.first);
+            writeValue(file, entry.second.format);
+            writeValue(file, size);
+            file.write(entry.second.binary.data(), size);
+        }
+        dirty = false;
+    }
+
+    // programs linked from the cache and programs that had to be compiled this run
+    int getHits() const
+    {
+        return hits;
+    }
+    int getMisses() const
+    {
+        return misses;
+    }
+
+private:
+    static const unsigned int MAGIC = 0x31425050;      // "PPB1"
+
+    struct Entry
+    {
+        GLenum format = 0;
+        std::vector<char> binary;
+        bool used = false;
+    };
+
+    ProgramBinaryCache() = default;
+
+    // FNV-1a, 64 bit
+    static unsigned long long hash(unsigned long long seed, const std::string& text)
+    {
+        unsigned long long h = seed ^ 14695981039346656037ull;
+        for (char c : text)
+        {
+            h ^= (unsigned char)c;
+            h *= 1099511628211ull;
+        }
+        return h;
+    }
+
+    template <typename T>
+    static void writeValue(std::ofstream& file, const T& value)
+    {
+        file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+    template <typename T>
+    static bool readValue(std::ifstream& file, T& value)
+    {
+        return (bool)file.read(reinterpret_cast<char*>(&value), sizeof(T));
+    }
+
+    // a missing file, another driver or a truncated entry leaves the cache empty
+    void readFile()
+    {
+        std::ifstream file(path, std::ios::binary);
+        unsigned int magic = 0, count = 0;
+        unsigned long long fileDriver = 0;
+        if (!file || !readValue(file, magic) || magic != MAGIC || !readValue(file, fileDriver) || !readValue(file, count))
+            return;
+        if (fileDriver != driverHash)
+        {
+            dirty = true;       // rewritten for this driver at exit
+            return;
+        }
+        for (unsigned int i = 0; i < count; i++)
+        {
+            unsigned long long entryKey = 0;
+            unsigned int size = 0;
+            Entry entry;
+            if (!readValue(file, entryKey) || !readValue(file, entry.format) || !readValue(file, size))
+                break;
+            entry.binary.resize(size);
+            if (!file.read(entry.binary.data(), size))
+                break;
+            entries[entryKey] = entry;
+        }
+    }
+
+    std::string path;
+    bool available = false;
+    bool dirty = false;
+    unsigned long long driverHash = 0;
+    ProgramBinaryGetProc getProgramBinary = nullptr;
+    ProgramBinaryLoadProc programBinary = nullptr;
+    ProgramParameterProc programParameteri = nullptr;
+    std::unordered_map<unsigned long long, Entry> entries;
+    int hits = 0;
+    int misses = 0;
+};
+
+#endif /* PROGRAM_BINARY_CACHE_H */
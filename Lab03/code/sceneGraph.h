@@ -0,0 +1,155 @@
+//
+//  sceneGraph.h
+//  parent/child transform hierarchy whose world matrices are recomputed only when dirtied
+//
+
+#ifndef SCENE_GRAPH_H
+#define SCENE_GRAPH_H
+
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+// local transform of a node: T(translation) * Rx * Ry * Rz * S(scale) * T(pivot), the order the
+// labs build their cubes in; rotation holds Euler angles in degrees
+struct SceneNode
+{
+    glm::vec3 translation = glm::vec3(0.0f);
+    glm::vec3 rotation = glm::vec3(0.0f);
+    glm::vec3 scale = glm::vec3(1.0f);
+    glm::vec3 pivot = glm::vec3(0.0f);
+    int parent = -1;
+    std::vector<int> children;
+    glm::mat4 world = glm::mat4(1.0f);
+    bool dirty = true;
+};
+
+class SceneGraph
+{
+public:
+    // parents must be added before their children, so one pass in index order updates the whole graph
+    int addNode(int parent = -1)
+    {
+        int index = (int)nodes.size();
+        nodes.push_back(SceneNode());
+        nodes[index].parent = parent;
+        if (parent >= 0)
+            nodes[parent].children.push_back(index);
+        dirtyCount++;
+        return index;
+    }
+
+    // the setters only dirty the node (and its subtree) when the value really changes
+    void setTranslation(int node, const glm::vec3& translation)
+    {
+        if (nodes[node].translation != translation)
+        {
+            nodes[node].translation = translation;
+            markDirty(node);
+        }
+    }
+    void setRotation(int node, const glm::vec3& degrees)
+    {
+        if (nodes[node].rotation != degrees)
+        {
+            nodes[node].rotation = degrees;
+            markDirty(node);
+        }
+    }
+    void setScale(int node, const glm::vec3& scale)
+    {
+        if (nodes[node].scale != scale)
+        {
+            nodes[node].scale = scale;
+            markDirty(node);
+        }
+    }
+    void setPivot(int node, const glm::vec3& pivot)
+    {
+        if (nodes[node].pivot != pivot)
+        {
+            nodes[node].pivot = pivot;
+            markDirty(node);
+        }
+    }
+
+    // recomputes the world matrix of every dirty node; call once per frame before reading matrices
+    void update()
+    {
+        recomputed = 0;
+        if (dirtyCount == 0)
+            return;
+        for (size_t i = 0; i < nodes.size(); i++)
+        {
+            SceneNode& node = nodes[i];
+            if (!node.dirty)
+                continue;
+            glm::mat4 parentWorld = node.parent >= 0 ? nodes[node.parent].world : glm::mat4(1.0f);
+            node.world = parentWorld * localMatrix(node);
+            node.dirty = false;
+            recomputed++;
+        }
+        dirtyCount = 0;
+    }
+
+    // cached world matrix, valid after update()
+    const glm::mat4& getWorld(int node) const
+    {
+        return nodes[node].world;
+    }
+    const SceneNode& getNode(int node) const
+    {
+        return nodes[node];
+    }
+    size_t getNodeCount() const
+    {
+        return nodes.size();
+    }
+    // world matrices rebuilt by the last update()
+    unsigned int getRecomputed() const
+    {
+        return recomputed;
+    }
+
+private:
+    static glm::mat4 localMatrix(const SceneNode& node)
+    {
+        glm::mat4 local = glm::translate(glm::mat4(1.0f), node.translation);
+        if (node.rotation.x != 0.0f)
+            local = glm::rotate(local, glm::radians(node.rotation.x), glm::vec3(1.0f, 0.0f, 0.0f));
+        if (node.rotation.y != 0.0f)
+            local = glm::rotate(local, glm::radians(node.rotation.y), glm::vec3(0.0f, 1.0f, 0.0f));
+        if (node.rotation.z != 0.0f)
+            local = glm::rotate(local, glm::radians(node.rotation.z), glm::vec3(0.0f, 0.0f, 1.0f));
+        local = glm::scale(local, node.scale);
+        if (node.pivot != glm::vec3(0.0f))
+            local = glm::translate(local, node.pivot);
+        return local;
+    }
+
+    // a node's world matrix depends on every ancestor, so the whole subtree goes stale with it
+    void markDirty(int node)
+    {
+        if (nodes[node].dirty)
+            return;     // its subtree was dirtied along with it
+        std::vector<int> stack(1, node);
+        while (!stack.empty())
+        {
+            int index = stack.back();
+            stack.pop_back();
+            if (!nodes[index].dirty)
+            {
+                nodes[index].dirty = true;
+                dirtyCount++;
+            }
+            for (size_t i = 0; i < nodes[index].children.size(); i++)
+                stack.push_back(nodes[index].children[i]);
+        }
+    }
+
+    std::vector<SceneNode> nodes;   // parents before children
+    unsigned int dirtyCount = 0;    // nodes waiting for update(), new ones included
+    unsigned int recomputed = 0;
+};
+
+#endif /* SCENE_GRAPH_H */
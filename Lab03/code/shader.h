@@ -3,20 +3,62 @@
 
 #include <glad/glad.h>
 #include <glm/glm.hpp>
+#include "affine.h"
+#include "programBinaryCache.h"
+#include "shaderCompiler.h"
+#include "uniformBlocks.h"
 
+#include <chrono>
+#include <cstring>
 #include <string>
+#include <vector>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 
+// pre-resolved uniform location: fetch it once with Shader::uniform() and reuse it every draw
+struct UniformHandle
+{
+    GLint location = -1;
+};
+
+// handles of the uniforms every lit draw uploads (index into the Materials block, model and
+// normal matrices and the dequantization of packed vertex positions)
+struct MaterialUniforms
+{
+    UniformHandle materialIndex;
+    UniformHandle model;
+    UniformHandle normalMatrix;
+    UniformHandle positionScale;
+    UniformHandle positionBias;
+};
+
+// handles of the procedural floor's chessboard (see drawFloor in main.cpp), -1 in programs without it
+struct CheckerUniforms
+{
+    UniformHandle checkerFloor;
+    UniformHandle checkerOrigin;
+    UniformHandle checkerTileSize;
+    UniformHandle checkerGridSize;
+};
+
 class Shader
 {
 public:
     unsigned int ID;
-    // constructor generates the shader on the fly
+    MaterialUniforms materialUniforms;
+    CheckerUniforms checkerUniforms;
+    // constructor generates the shader on the fly; each name in defines becomes a #define
+    // in every stage, right after the #version line (see shaderVariants.h)
+    // with waitForLink false the compile and link are only issued: the driver may work on them in the
+    // background while isReady() polls, and the first use() waits for whatever is left
     // ------------------------------------------------------------------------
-    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
+    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr,
+        const std::vector<std::string>& defines = std::vector<std::string>(), bool waitForLink = true)
     {
+        ShaderCompiler& compiler = ShaderCompiler::current();
+        compiler.addProgram();
+        auto start = std::chrono::steady_clock::now();
         // 1. retrieve the vertex/fragment source code from filePath
         std::string vertexCode;
         std::string fragmentCode;
@@ -57,111 +99,470 @@ public:
         {
             std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << e.what() << std::endl;
         }
-        const char* vShaderCode = vertexCode.c_str();
-        const char* fShaderCode = fragmentCode.c_str();
-        // 2. compile shaders
-        unsigned int vertex, fragment;
-        // vertex shader
-        vertex = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertex, 1, &vShaderCode, NULL);
-        glCompileShader(vertex);
-        checkCompileErrors(vertex, "VERTEX");
-        // fragment Shader
-        fragment = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragment, 1, &fShaderCode, NULL);
-        glCompileShader(fragment);
-        checkCompileErrors(fragment, "FRAGMENT");
-        // if geometry shader is given, compile geometry shader
-        unsigned int geometry;
-        if (geometryPath != nullptr)
+        if (!defines.empty())
         {
-            const char* gShaderCode = geometryCode.c_str();
-            geometry = glCreateShader(GL_GEOMETRY_SHADER);
-            glShaderSource(geometry, 1, &gShaderCode, NULL);
-            glCompileShader(geometry);
-            checkCompileErrors(geometry, "GEOMETRY");
+            vertexCode = injectDefines(vertexCode, defines);
+            fragmentCode = injectDefines(fragmentCode, defines);
+            if (geometryPath != nullptr)
+                geometryCode = injectDefines(geometryCode, defines);
         }
-        // shader Program
+        compiler.addFileTime(millisecondsSince(start));
+
+        // a program linked before from the same sources is loaded from the binary cache instead
+        ProgramBinaryCache& binaryCache = ProgramBinaryCache::current();
+        binaryKey = binaryCache.key(vertexCode, fragmentCode, geometryCode);
         ID = glCreateProgram();
-        glAttachShader(ID, vertex);
-        glAttachShader(ID, fragment);
-        if (geometryPath != nullptr)
-            glAttachShader(ID, geometry);
-        glLinkProgram(ID);
+        start = std::chrono::steady_clock::now();
+        bool loaded = binaryCache.load(ID, binaryKey);
+        compiler.addLinkTime(millisecondsSince(start));
+        if (loaded)
+            resolveUniforms();
+        else
+        {
+            compileAndLink(vertexCode, fragmentCode, geometryPath != nullptr ? &geometryCode : nullptr);
+            if (waitForLink)
+                finishLink();
+        }
+    }
+    // true once the program is linked; never blocks when the driver can report completion
+    // ------------------------------------------------------------------------
+    bool isReady()
+    {
+        if (!pending)
+            return true;
+        if (ShaderCompiler::current().isParallel())
+        {
+            GLint complete = 0;
+            glGetProgramiv(ID, GL_COMPLETION_STATUS_KHR, &complete);
+            if (!complete)
+                return false;
+        }
+        finishLink();
+        return true;
+    }
+    // waits for the link issued by the constructor, reports errors and fills the uniform table
+    // ------------------------------------------------------------------------
+    void finishLink()
+    {
+        if (!pending)
+            return;
+        auto start = std::chrono::steady_clock::now();
+        const char* stageNames[3] = { "VERTEX", "FRAGMENT", "GEOMETRY" };
+        for (int i = 0; i < 3; i++)
+            if (pendingStages[i] != 0)
+            {
+                checkCompileErrors(pendingStages[i], stageNames[i]);
+                // delete the shaders as they're linked into our program now and no longer necessary
+                glDeleteShader(pendingStages[i]);
+                pendingStages[i] = 0;
+            }
         checkCompileErrors(ID, "PROGRAM");
-        // delete the shaders as they're linked into our program now and no longer necessary
-        glDeleteShader(vertex);
-        glDeleteShader(fragment);
-        if (geometryPath != nullptr)
-            glDeleteShader(geometry);
-
+        GLint linked = 0;
+        glGetProgramiv(ID, GL_LINK_STATUS, &linked);
+        ShaderCompiler::current().addWaitTime(millisecondsSince(start));
+        if (linked)
+            ProgramBinaryCache::current().store(ID, binaryKey);
+        resolveUniforms();
     }
     // activate the shader
     // ------------------------------------------------------------------------
     void use()
     {
+        finishLink();
         glUseProgram(ID);
     }
-    // utility uniform functions
+    // utility uniform functions; each compares with the value the location was last given and skips
+    // the glUniform* call when nothing changed
+    // ------------------------------------------------------------------------
+    void setBool(const char* name, bool value) const
+    {
+        setInt(name, (int)value);
+    }
+    // ------------------------------------------------------------------------
+    void setInt(const char* name, int value) const
+    {
+        GLint location = findUniform(name);
+        if (changed(location, &value, sizeof(value)))
+            glUniform1i(location, value);
+    }
     // ------------------------------------------------------------------------
-    void setBool(const std::string& name, bool value) const
+    void setFloat(const char* name, float value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+        GLint location = findUniform(name);
+        if (changed(location, &value, sizeof(value)))
+            glUniform1f(location, value);
     }
     // ------------------------------------------------------------------------
-    void setInt(const std::string& name, int value) const
+    void setVec2(const char* name, const glm::vec2& value) const
+    {
+        GLint location = findUniform(name);
+        if (changed(location, &value, sizeof(value)))
+            glUniform2fv(location, 1, &value[0]);
+    }
+    void setVec2(const char* name, float x, float y) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+        setVec2(name, glm::vec2(x, y));
     }
     // ------------------------------------------------------------------------
-    void setFloat(const std::string& name, float value) const
+    void setVec3(const char* name, const glm::vec3& value) const
+    {
+        GLint location = findUniform(name);
+        if (changed(location, &value, sizeof(value)))
+            glUniform3fv(location, 1, &value[0]);
+    }
+    void setVec3(const char* name, float x, float y, float z) const
     {
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+        setVec3(name, glm::vec3(x, y, z));
     }
     // ------------------------------------------------------------------------
-    void setVec2(const std::string& name, const glm::vec2& value) const
+    void setVec4(const char* name, const glm::vec4& value) const
     {
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        GLint location = findUniform(name);
+        if (changed(location, &value, sizeof(value)))
+            glUniform4fv(location, 1, &value[0]);
     }
-    void setVec2(const std::string& name, float x, float y) const
+    void setVec4(const char* name, float x, float y, float z, float w)
     {
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+        setVec4(name, glm::vec4(x, y, z, w));
     }
     // ------------------------------------------------------------------------
-    void setVec3(const std::string& name, const glm::vec3& value) const
+    void setMat2(const char* name, const glm::mat2& mat) const
     {
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        GLint location = findUniform(name);
+        if (changed(location, &mat, sizeof(mat)))
+            glUniformMatrix2fv(location, 1, GL_FALSE, &mat[0][0]);
     }
-    void setVec3(const std::string& name, float x, float y, float z) const
+    // ------------------------------------------------------------------------
+    void setMat3(const char* name, const glm::mat3& mat) const
     {
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+        GLint location = findUniform(name);
+        if (changed(location, &mat, sizeof(mat)))
+            glUniformMatrix3fv(location, 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
-    void setVec4(const std::string& name, const glm::vec4& value) const
+    void setMat4(const char* name, const glm::mat4& mat) const
     {
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        GLint location = findUniform(name);
+        if (changed(location, &mat, sizeof(mat)))
+            glUniformMatrix4fv(location, 1, GL_FALSE, &mat[0][0]);
     }
-    void setVec4(const std::string& name, float x, float y, float z, float w)
+    // ------------------------------------------------------------------------
+    // mat3x4 uniform holding the rows of an affine matrix
+    void setAffine(const char* name, const Affine& affine) const
     {
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+        GLint location = findUniform(name);
+        if (changed(location, &affine.rows[0][0], sizeof(affine.rows)))
+            glUniformMatrix3x4fv(location, 1, GL_FALSE, &affine.rows[0][0]);
     }
+    // resolve a uniform once; uploads through the handle skip the name lookup entirely
     // ------------------------------------------------------------------------
-    void setMat2(const std::string& name, const glm::mat2& mat) const
+    UniformHandle uniform(const char* name) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        UniformHandle handle;
+        handle.location = findUniform(name);
+        return handle;
     }
+    // utility uniform functions taking pre-resolved handles (per-draw path)
     // ------------------------------------------------------------------------
-    void setMat3(const std::string& name, const glm::mat3& mat) const
+    void setBool(UniformHandle handle, bool value) const
+    {
+        setInt(handle, (int)value);
+    }
+    void setInt(UniformHandle handle, int value) const
+    {
+        handleUploads++;
+        if (changed(handle.location, &value, sizeof(value)))
+            glUniform1i(handle.location, value);
+    }
+    void setFloat(UniformHandle handle, float value) const
+    {
+        handleUploads++;
+        if (changed(handle.location, &value, sizeof(value)))
+            glUniform1f(handle.location, value);
+    }
+    void setVec2(UniformHandle handle, const glm::vec2& value) const
+    {
+        handleUploads++;
+        if (changed(handle.location, &value, sizeof(value)))
+            glUniform2fv(handle.location, 1, &value[0]);
+    }
+    void setVec3(UniformHandle handle, const glm::vec3& value) const
+    {
+        handleUploads++;
+        if (changed(handle.location, &value, sizeof(value)))
+            glUniform3fv(handle.location, 1, &value[0]);
+    }
+    void setVec4(UniformHandle handle, const glm::vec4& value) const
+    {
+        handleUploads++;
+        if (changed(handle.location, &value, sizeof(value)))
+            glUniform4fv(handle.location, 1, &value[0]);
+    }
+    void setMat3(UniformHandle handle, const glm::mat3& mat) const
+    {
+        handleUploads++;
+        if (changed(handle.location, &mat, sizeof(mat)))
+            glUniformMatrix3fv(handle.location, 1, GL_FALSE, &mat[0][0]);
+    }
+    void setMat4(UniformHandle handle, const glm::mat4& mat) const
+    {
+        handleUploads++;
+        if (changed(handle.location, &mat, sizeof(mat)))
+            glUniformMatrix4fv(handle.location, 1, GL_FALSE, &mat[0][0]);
+    }
+    void setAffine(UniformHandle handle, const Affine& affine) const
+    {
+        handleUploads++;
+        if (changed(handle.location, &affine.rows[0][0], sizeof(affine.rows)))
+            glUniformMatrix3x4fv(handle.location, 1, GL_FALSE, &affine.rows[0][0]);
+    }
+    // model matrix of a lit draw together with its normal matrix, so no vertex has to invert it
+    void setModel(const Affine& model) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        setAffine(materialUniforms.model, model);
+        setMat3(materialUniforms.normalMatrix, model.normalMatrix());
     }
+    // uniform lookup statistics, reset once per frame: uploads by name still hash the name into the
+    // reflection table (no glGetUniformLocation call), uploads through a handle skip the lookup entirely
     // ------------------------------------------------------------------------
-    void setMat4(const std::string& name, const glm::mat4& mat) const
+    void resetUniformStats()
+    {
+        tableLookups = 0;
+        handleUploads = 0;
+        uploadsIssued = 0;
+        uploadsSkipped = 0;
+    }
+    unsigned int getNameLookups() const
+    {
+        return tableLookups;
+    }
+    unsigned int getHandleUploads() const
+    {
+        return handleUploads;
+    }
+    // set* calls that reached the driver and calls that repeated the value the program already held
+    unsigned int getUploadsIssued() const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        return uploadsIssued;
+    }
+    unsigned int getUploadsSkipped() const
+    {
+        return uploadsSkipped;
     }
 
 private:
+    bool pending = false;                       // link issued, status not collected yet
+    unsigned int pendingStages[3] = { 0, 0, 0 };  // vertex, fragment, geometry until finishLink()
+    unsigned long long binaryKey = 0;
+
+    static double millisecondsSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // 2. compile the stages from source and link them into ID without asking for the results, so the
+    // driver is free to finish them later; the geometry stage is optional
+    // ------------------------------------------------------------------------
+    void compileAndLink(const std::string& vertexCode, const std::string& fragmentCode, const std::string* geometryCode)
+    {
+        auto start = std::chrono::steady_clock::now();
+        pendingStages[0] = compileStage(GL_VERTEX_SHADER, vertexCode);
+        pendingStages[1] = compileStage(GL_FRAGMENT_SHADER, fragmentCode);
+        if (geometryCode != nullptr)
+            pendingStages[2] = compileStage(GL_GEOMETRY_SHADER, *geometryCode);
+        ShaderCompiler::current().addCompileTime(millisecondsSince(start));
+
+        // shader Program
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < 3; i++)
+            if (pendingStages[i] != 0)
+                glAttachShader(ID, pendingStages[i]);
+        ProgramBinaryCache::current().prepare(ID);
+        glLinkProgram(ID);
+        ShaderCompiler::current().addLinkTime(millisecondsSince(start));
+        pending = true;
+    }
+
+    static unsigned int compileStage(GLenum type, const std::string& code)
+    {
+        const char* source = code.c_str();
+        unsigned int stage = glCreateShader(type);
+        glShaderSource(stage, 1, &source, NULL);
+        glCompileShader(stage);
+        return stage;
+    }
+
+    // uniform table, the per-draw handles and the shared block bindings (see uniformBlocks.h), once the
+    // program is linked; cached programs are bound again too, a binary need not keep the bindings
+    // ------------------------------------------------------------------------
+    void resolveUniforms()
+    {
+        pending = false;
+        buildUniformTable();
+        bindUniformBlocks(ID);
+
+        materialUniforms.materialIndex = uniform("materialIndex");
+        materialUniforms.model = uniform("model");
+        materialUniforms.normalMatrix = uniform("normalMatrix");
+        materialUniforms.positionScale = uniform("positionScale");
+        materialUniforms.positionBias = uniform("positionBias");
+        checkerUniforms.checkerFloor = uniform("checkerFloor");
+        checkerUniforms.checkerOrigin = uniform("checkerOrigin");
+        checkerUniforms.checkerTileSize = uniform("checkerTileSize");
+        checkerUniforms.checkerGridSize = uniform("checkerGridSize");
+    }
+
+    // one slot of the open-addressing uniform table (empty name = free slot)
+    struct UniformEntry
+    {
+        unsigned int hash = 0;
+        GLint location = -1;
+        std::string name;
+    };
+    std::vector<UniformEntry> uniformTable;     // power-of-two size, at most half full
+    mutable unsigned int tableLookups = 0;
+    mutable unsigned int handleUploads = 0;
+    // bytes each location was last uploaded with, indexed by location; empty until the first upload
+    mutable std::vector<std::vector<unsigned char>> shadow;
+    mutable unsigned int uploadsIssued = 0;
+    mutable unsigned int uploadsSkipped = 0;
+
+    // true (and the shadow updated) if the upload must go out; inactive uniforms are never sent
+    bool changed(GLint location, const void* value, size_t bytes) const
+    {
+        if (location < 0)
+            return false;
+        if ((size_t)location >= shadow.size())
+            shadow.resize(location + 1);
+        std::vector<unsigned char>& last = shadow[location];
+        if (last.size() == bytes && std::memcmp(last.data(), value, bytes) == 0)
+        {
+            uploadsSkipped++;
+            return false;
+        }
+        const unsigned char* bytesIn = static_cast<const unsigned char*>(value);
+        last.assign(bytesIn, bytesIn + bytes);
+        uploadsIssued++;
+        return true;
+    }
+
+    static unsigned int hashName(const char* name)
+    {
+        // FNV-1a
+        unsigned int hash = 2166136261u;
+        for (; *name != '\0'; name++)
+        {
+            hash ^= (unsigned char)*name;
+            hash *= 16777619u;
+        }
+        return hash;
+    }
+
+    void insertUniform(const std::string& name, GLint location)
+    {
+        unsigned int hash = hashName(name.c_str());
+        size_t mask = uniformTable.size() - 1;
+        for (size_t i = hash & mask; ; i = (i + 1) & mask)
+        {
+            UniformEntry& entry = uniformTable[i];
+            if (entry.name.empty())
+            {
+                entry.hash = hash;
+                entry.location = location;
+                entry.name = name;
+                return;
+            }
+            if (entry.hash == hash && entry.name == name)
+                return;
+        }
+    }
+
+    // enumerate the active uniforms once after linking so no set* call has to ask the driver
+    // ------------------------------------------------------------------------
+    void buildUniformTable()
+    {
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+        std::vector<std::pair<std::string, GLint>> found;
+        std::vector<GLchar> nameBuffer(maxLength > 0 ? maxLength : 1);
+        for (GLint i = 0; i < count; i++)
+        {
+            GLint size = 0;
+            GLenum type = 0;
+            GLsizei length = 0;
+            glGetActiveUniform(ID, (GLuint)i, (GLsizei)nameBuffer.size(), &length, &size, &type, nameBuffer.data());
+            std::string name(nameBuffer.data(), length);
+            GLint location = glGetUniformLocation(ID, name.c_str());
+            if (location < 0)
+                continue;       // uniform block member, has no location
+            found.push_back(std::make_pair(name, location));
+
+            // arrays of basic types are reported once as "name[0]": register "name" and every element too
+            if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+            {
+                std::string base = name.substr(0, name.size() - 3);
+                found.push_back(std::make_pair(base, location));
+                for (GLint e = 1; e < size; e++)
+                {
+                    std::string element = base + "[" + std::to_string(e) + "]";
+                    found.push_back(std::make_pair(element, glGetUniformLocation(ID, element.c_str())));
+                }
+            }
+        }
+
+        size_t capacity = 16;
+        while (capacity < found.size() * 2)
+            capacity <<= 1;
+        uniformTable.assign(capacity, UniformEntry());
+        for (size_t i = 0; i < found.size(); i++)
+            insertUniform(found[i].first, found[i].second);
+    }
+
+    // -1 for names that are not active, exactly like glGetUniformLocation
+    GLint findUniform(const char* name) const
+    {
+        tableLookups++;
+        if (uniformTable.empty())
+            return -1;
+        unsigned int hash = hashName(name);
+        size_t mask = uniformTable.size() - 1;
+        for (size_t i = hash & mask; ; i = (i + 1) & mask)
+        {
+            const UniformEntry& entry = uniformTable[i];
+            if (entry.name.empty())
+                return -1;
+            if (entry.hash == hash && entry.name == name)
+                return entry.location;
+        }
+    }
+
+    // the defines go after the #version line, which must stay first; #line keeps error line numbers
+    // pointing at the file
+    // ------------------------------------------------------------------------
+    static std::string injectDefines(const std::string& code, const std::vector<std::string>& defines)
+    {
+        std::string result = code;
+        size_t versionEnd = 0;
+        if (result.compare(0, 8, "#version") == 0)
+        {
+            versionEnd = result.find('\n');
+            if (versionEnd == std::string::npos)
+            {
+                versionEnd = result.size();
+                result += '\n';
+            }
+            versionEnd++;
+        }
+        std::string block;
+        for (size_t i = 0; i < defines.size(); i++)
+            block += "#define " + defines[i] + "\n";
+        block += "#line " + std::to_string(versionEnd > 0 ? 2 : 1) + "\n";
+        result.insert(versionEnd, block);
+        return result;
+    }
+
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     void checkCompileErrors(GLuint shader, std::string type)
@@ -0,0 +1,101 @@
+//
+//  shaderCompiler.h
+//  driver-side parallel shader compilation and where shader startup time goes
+//
+
+#ifndef SHADER_COMPILER_H
+#define SHADER_COMPILER_H
+
+#include <cstring>
+#include <iostream>
+#include <glad/glad.h>
+
+// KHR_parallel_shader_compile is not in the GL 3.3 loader either
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+typedef void (APIENTRYP MaxShaderCompilerThreadsProc)(GLuint count);
+
+inline bool hasGLExtension(const char* name)
+{
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; i++)
+    {
+        const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, (GLuint)i);
+        if (extension != nullptr && std::strcmp(extension, name) == 0)
+            return true;
+    }
+    return false;
+}
+
+// with KHR_parallel_shader_compile the driver compiles and links on its own threads and a program's
+// completion can be polled; without it Shader::isReady() simply waits for the link
+class ShaderCompiler
+{
+public:
+    static ShaderCompiler& current()
+    {
+        static ShaderCompiler compiler;
+        return compiler;
+    }
+
+    // after the context is current
+    void init(GLADloadproc loader)
+    {
+        if (!hasGLExtension("GL_KHR_parallel_shader_compile"))
+            return;
+        MaxShaderCompilerThreadsProc maxShaderCompilerThreads = (MaxShaderCompilerThreadsProc)loader("glMaxShaderCompilerThreadsKHR");
+        if (maxShaderCompilerThreads != nullptr)
+            maxShaderCompilerThreads(0xFFFFFFFF);   // as many threads as the driver likes
+        parallel = true;
+    }
+
+    bool isParallel() const
+    {
+        return parallel;
+    }
+
+    // CPU time of each step, summed over every program built so far
+    void addFileTime(double ms)
+    {
+        fileMs += ms;
+    }
+    void addCompileTime(double ms)
+    {
+        compileMs += ms;
+    }
+    void addLinkTime(double ms)
+    {
+        linkMs += ms;
+    }
+    void addWaitTime(double ms)
+    {
+        waitMs += ms;
+    }
+    void addProgram()
+    {
+        programs++;
+    }
+
+    // totalMs is the wall time from the first program issued to the first frame drawn with the real ones
+    void report(double totalMs, int fromBinaries) const
+    {
+        std::cout << "shader startup: " << programs << " programs (" << fromBinaries << " from binaries) in " << totalMs << " ms; "
+            << fileMs << " ms file I/O, " << compileMs << " ms compile, " << linkMs << " ms link, "
+            << waitMs << " ms waiting for the driver" << (parallel ? " (parallel compile)" : "") << std::endl;
+    }
+
+private:
+    ShaderCompiler() = default;
+
+    bool parallel = false;
+    int programs = 0;
+    double fileMs = 0.0;
+    double compileMs = 0.0;
+    double linkMs = 0.0;
+    double waitMs = 0.0;
+};
+
+#endif /* SHADER_COMPILER_H */
@@ -0,0 +1,136 @@
+//
+//  shaderVariants.h
+//  compile-time permutations of one shader pair, built on first use and kept by feature key
+//
+
+#ifndef SHADER_VARIANTS_H
+#define SHADER_VARIANTS_H
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "shader.h"
+
+// bit i of a key turns on the i-th define, so a feature switched off at runtime is compiled out of the
+// program instead of being evaluated with zero colors; toggling it switches programs
+// variants are compiled asynchronously: request() only issues the work, and getOrFallback() draws with
+// a cheap program until the driver has linked the real one
+class ShaderVariants
+{
+public:
+    // onCompile runs once for every new program after it is linked, e.g. to set uniforms that never change
+    ShaderVariants(const char* vertexPath, const char* fragmentPath, const std::vector<std::string>& featureDefines,
+        std::function<void(Shader&)> onCompile = nullptr)
+        : vertexPath(vertexPath), fragmentPath(fragmentPath), featureDefines(featureDefines), onCompile(onCompile)
+    {
+    }
+    ShaderVariants(const ShaderVariants&) = delete;
+    ShaderVariants& operator=(const ShaderVariants&) = delete;
+
+    // starts compiling the program for this key unless it exists already; returns at once
+    void request(unsigned int key)
+    {
+        variant(key);
+    }
+
+    // the program for this key, waiting for its compile and link if needed
+    Shader& get(unsigned int key)
+    {
+        Variant& found = variant(key);
+        found.shader->finishLink();
+        return prepared(found);
+    }
+
+    // the program for this key if the driver has linked it, fallback until then
+    Shader& getOrFallback(unsigned int key, Shader& fallback)
+    {
+        Variant& found = variant(key);
+        if (!found.shader->isReady())
+            return fallback;
+        return prepared(found);
+    }
+
+    // uniform statistics summed over every compiled variant
+    void resetUniformStats()
+    {
+        for (auto& variant : variants)
+            variant.second.shader->resetUniformStats();
+    }
+    unsigned int getNameLookups() const
+    {
+        unsigned int total = 0;
+        for (const auto& variant : variants)
+            total += variant.second.shader->getNameLookups();
+        return total;
+    }
+    unsigned int getHandleUploads() const
+    {
+        unsigned int total = 0;
+        for (const auto& variant : variants)
+            total += variant.second.shader->getHandleUploads();
+        return total;
+    }
+
+    unsigned int getUploadsIssued() const
+    {
+        unsigned int total = 0;
+        for (const auto& variant : variants)
+            total += variant.second.shader->getUploadsIssued();
+        return total;
+    }
+    unsigned int getUploadsSkipped() const
+    {
+        unsigned int total = 0;
+        for (const auto& variant : variants)
+            total += variant.second.shader->getUploadsSkipped();
+        return total;
+    }
+
+    int getVariantCount() const
+    {
+        return (int)variants.size();
+    }
+
+private:
+    struct Variant
+    {
+        std::unique_ptr<Shader> shader;
+        bool prepared = false;      // onCompile has run
+    };
+
+    Variant& variant(unsigned int key)
+    {
+        auto found = variants.find(key);
+        if (found != variants.end())
+            return found->second;
+
+        std::vector<std::string> defines;
+        for (size_t i = 0; i < featureDefines.size(); i++)
+            if (key & (1u << i))
+                defines.push_back(featureDefines[i]);
+        Variant& created = variants[key];
+        created.shader.reset(new Shader(vertexPath.c_str(), fragmentPath.c_str(), nullptr, defines, false));
+        return created;
+    }
+
+    Shader& prepared(Variant& entry)
+    {
+        if (!entry.prepared)
+        {
+            if (onCompile)
+                onCompile(*entry.shader);
+            entry.prepared = true;
+        }
+        return *entry.shader;
+    }
+
+    std::string vertexPath;
+    std::string fragmentPath;
+    std::vector<std::string> featureDefines;
+    std::function<void(Shader&)> onCompile;
+    std::unordered_map<unsigned int, Variant> variants;
+};
+
+#endif /* SHADER_VARIANTS_H */
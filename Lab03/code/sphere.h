@@ -9,11 +9,14 @@
 #define sphere_h
 
 #include <glad/glad.h>
+#include <algorithm>
 #include <vector>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include "shader.h"
+#include "meshCache.h"
+#include "materialTable.h"
 
 # define PI 3.1416
 
@@ -37,43 +40,20 @@ public:
         double shiny = 32.0f) : verticesStride(24)
     {
         set(radius, sectorCount, stackCount, amb, diff, spec, shiny);
-        buildCoordinatesAndIndices();
-        buildVertices();
-
-        glGenVertexArrays(1, &sphereVAO);
-        glBindVertexArray(sphereVAO);
-
-        // create VBO to copy vertex data to VBO
-        unsigned int sphereVBO;
-        glGenBuffers(1, &sphereVBO);
-        glBindBuffer(GL_ARRAY_BUFFER, sphereVBO);           // for vertex data
-        glBufferData(GL_ARRAY_BUFFER,                   // target
-            this->getVertexSize(), // data size, # of bytes
-            this->getVertices(),   // ptr to vertex data
-            GL_STATIC_DRAW);                   // usage
-
-        // create EBO to copy index data
-        unsigned int sphereEBO;
-        glGenBuffers(1, &sphereEBO);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sphereEBO);   // for index data
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER,           // target
-            this->getIndexSize(),             // data size, # of bytes
-            this->getIndices(),               // ptr to index data
-            GL_STATIC_DRAW);                   // usage
-
-        // activate attrib arrays
-        glEnableVertexAttribArray(0);
-        glEnableVertexAttribArray(1);
-
-        // set attrib arrays with stride and offset
-        int stride = this->getVerticesStride();     // should be 24 bytes
-        glVertexAttribPointer(0, 3, GL_FLOAT, false, stride, (void*)0);
-        glVertexAttribPointer(1, 3, GL_FLOAT, false, stride, (void*)(sizeof(float) * 3));
-
-        // unbind VAO and VBOs
-        glBindVertexArray(0);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+        // one tessellation per LOD level, each shared with every sphere of the same radius and sector/stack counts
+        for (int level = 0; level < MAX_LOD_LEVELS; level++)
+        {
+            int sectors = max(this->sectorCount >> level, MIN_SECTOR_COUNT);
+            int stacks = max(this->stackCount >> level, MIN_STACK_COUNT);
+            lods[level] = MeshCache::instance().acquire(MeshKey(SHAPE_SPHERE, this->radius, 0.0f, 0.0f, sectors, stacks),
+                [this, sectors, stacks](vector<float>& vertices, vector<unsigned int>& indices)
+                {
+                    vector<float> coordinates, normals;
+                    buildCoordinatesAndIndices(sectors, stacks, coordinates, normals, indices);
+                    buildVertices(coordinates, normals, vertices);
+                });
+        }
     }
     ~Sphere() {}
 
@@ -116,12 +96,12 @@ public:
     // for interleaved vertices
     unsigned int getVertexCount() const
     {
-        return (unsigned int)coordinates.size() / 3;     // # of vertices
+        return (unsigned int)lods[0]->vertices.size() / 6;  // # of vertices
     }
 
     unsigned int getVertexSize() const
     {
-        return (unsigned int)vertices.size() * sizeof(float);  // # of bytes
+        return (unsigned int)lods[0]->vertices.size() * sizeof(float);  // # of bytes
     }
 
     int getVerticesStride() const
@@ -130,50 +110,57 @@ public:
     }
     const float* getVertices() const
     {
-        return vertices.data();
+        return lods[0]->vertices.data();
     }
 
     unsigned int getIndexSize() const
     {
-        return (unsigned int)indices.size() * sizeof(unsigned int);
+        return (unsigned int)lods[0]->indices.size() * sizeof(unsigned int);
     }
 
     const unsigned int* getIndices() const
     {
-        return indices.data();
+        return lods[0]->indices.data();
     }
 
     unsigned int getIndexCount() const
     {
-        return (unsigned int)indices.size();
+        return (unsigned int)lods[0]->indices.size();
+    }
+
+    // where the full detail sphere lives in the mesh arena, for multi-draw lists
+    const MeshRange& getMeshRange() const
+    {
+        return lods[0]->range;
+    }
+
+    // full detail mesh, for its object space bounds
+    const ParametricMesh& getMesh() const
+    {
+        return *lods[0];
     }
 
     // draw in VertexArray mode
-    void drawSphere(Shader& lightingShader, glm::mat4 model) const      // draw surface
+    void drawSphere(Shader& lightingShader, glm::mat4 model, LodState* lod = nullptr) const      // draw surface
     {
-        lightingShader.use();
+        if (!meshVisible(*lods[0], model))
+            return;
 
-        lightingShader.setVec3("material.ambient", this->ambient);
-        lightingShader.setVec3("material.diffuse", this->diffuse);
-        lightingShader.setVec3("material.specular", this->specular);
-        lightingShader.setFloat("material.shininess", this->shininess);
+        lightingShader.use();
 
-        lightingShader.setMat4("model", model);
+        // the material lives in the shared Materials block; the draw only picks it
+        int material = MaterialTable::current().index(this->ambient, this->diffuse, this->specular, this->shininess);
+        lightingShader.setInt(lightingShader.materialUniforms.materialIndex, material);
 
-        // draw a sphere with VAO
-        glBindVertexArray(sphereVAO);
-        glDrawElements(GL_TRIANGLES,                    // primitive type
-            this->getIndexCount(),          // # of indices
-            GL_UNSIGNED_INT,                 // data type
-            (void*)0);                       // offset to indices
+        lightingShader.setModel(Affine(model));
 
-        // unbind VAO
-        glBindVertexArray(0);
+        // draw the tessellation that matches the sphere's size on screen
+        selectLod(lods, model, lod).draw(lightingShader);
     }
 
 private:
     // member functions
-    void buildCoordinatesAndIndices()
+    void buildCoordinatesAndIndices(int sectorCount, int stackCount, vector<float>& coordinates, vector<float>& normals, vector<unsigned int>& indices)
     {
         float x, y, z, xz;                              // vertex position
         float nx, ny, nz, lengthInv = 1.0f / radius;    // vertex normal
@@ -257,7 +244,7 @@ private:
         }
     }
 
-    void buildVertices()
+    void buildVertices(const vector<float>& coordinates, const vector<float>& normals, vector<float>& vertices)
     {
         size_t i, j;
         size_t count = coordinates.size();
@@ -308,14 +295,10 @@ private:
     }
 
     // memeber vars
-    unsigned int sphereVAO;
+    shared_ptr<const ParametricMesh> lods[MAX_LOD_LEVELS];  // shared geometry, finest first, see meshCache.h
     float radius;
     int sectorCount;                        // longitude, # of slices
     int stackCount;                         // latitude, # of stacks
-    vector<float> vertices;
-    vector<float> normals;
-    vector<unsigned int> indices;
-    vector<float> coordinates;
     int verticesStride;                 // # of bytes to hop to the next vertex (should be 24 bytes)
 
 };
@@ -0,0 +1,309 @@
+//
+//  transformStore.h
+//  structure-of-arrays node transforms composed into affine world matrices several nodes at a time
+//
+
+#ifndef TRANSFORM_STORE_H
+#define TRANSFORM_STORE_H
+
+#include <cmath>
+#include <vector>
+#include <glm/glm.hpp>
+#include "affine.h"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TRANSFORM_SSE 1
+#endif
+
+// the vector type the kernel is written against: 8 floats with AVX, 4 with SSE, 1 otherwise
+struct TransformLanes
+{
+#if defined(__AVX__)
+    typedef __m256 Type;
+    static const int WIDTH = 8;
+    static Type zero() { return _mm256_setzero_ps(); }
+    static Type load(const float* p) { return _mm256_loadu_ps(p); }
+    static void store(float* p, Type v) { _mm256_storeu_ps(p, v); }
+    static Type add(Type a, Type b) { return _mm256_add_ps(a, b); }
+    static Type sub(Type a, Type b) { return _mm256_sub_ps(a, b); }
+    static Type mul(Type a, Type b) { return _mm256_mul_ps(a, b); }
+    static Type set(float v) { return _mm256_set1_ps(v); }
+    static Type max(Type a, Type b) { return _mm256_max_ps(a, b); }
+    // one bit per lane where a <= b
+    static int lessEqual(Type a, Type b) { return _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_LE_OQ)); }
+#elif defined(TRANSFORM_SSE)
+    typedef __m128 Type;
+    static const int WIDTH = 4;
+    static Type zero() { return _mm_setzero_ps(); }
+    static Type load(const float* p) { return _mm_loadu_ps(p); }
+    static void store(float* p, Type v) { _mm_storeu_ps(p, v); }
+    static Type add(Type a, Type b) { return _mm_add_ps(a, b); }
+    static Type sub(Type a, Type b) { return _mm_sub_ps(a, b); }
+    static Type mul(Type a, Type b) { return _mm_mul_ps(a, b); }
+    static Type set(float v) { return _mm_set1_ps(v); }
+    static Type max(Type a, Type b) { return _mm_max_ps(a, b); }
+    static int lessEqual(Type a, Type b) { return _mm_movemask_ps(_mm_cmple_ps(a, b)); }
+#else
+    typedef float Type;
+    static const int WIDTH = 1;
+    static Type zero() { return 0.0f; }
+    static Type load(const float* p) { return *p; }
+    static void store(float* p, Type v) { *p = v; }
+    static Type add(Type a, Type b) { return a + b; }
+    static Type sub(Type a, Type b) { return a - b; }
+    static Type mul(Type a, Type b) { return a * b; }
+    static Type set(float v) { return v; }
+    static Type max(Type a, Type b) { return a > b ? a : b; }
+    static int lessEqual(Type a, Type b) { return a <= b ? 1 : 0; }
+#endif
+};
+
+// node transforms as T(position) * Rx * Ry * Rz * S(scale), the order the draw functions compose
+// them in. Every component lives in its own array so one kernel pass loads WIDTH nodes per register;
+// parents must come before their children (topological order)
+class TransformStore
+{
+public:
+    // entries of the 3x4 affine world matrix, column major: m[column * 3 + row]
+    static const int MATRIX_FLOATS = 12;
+
+    int add(int parent, const glm::vec3& position, const glm::vec3& degrees, const glm::vec3& scale)
+    {
+        int index = (int)parents.size();
+        parents.push_back(parent);
+        for (int axis = 0; axis < 3; axis++)
+        {
+            positions[axis].push_back(position[axis]);
+            scales[axis].push_back(scale[axis]);
+            cosines[axis].push_back(1.0f);
+            sines[axis].push_back(0.0f);
+        }
+        for (int i = 0; i < MATRIX_FLOATS; i++)
+        {
+            local[i].push_back(0.0f);
+            world[i].push_back(0.0f);
+        }
+        setRotation(index, degrees);
+        dirty = true;
+        return index;
+    }
+
+    void clear()
+    {
+        parents.clear();
+        for (int axis = 0; axis < 3; axis++)
+        {
+            positions[axis].clear();
+            scales[axis].clear();
+            cosines[axis].clear();
+            sines[axis].clear();
+        }
+        for (int i = 0; i < MATRIX_FLOATS; i++)
+        {
+            local[i].clear();
+            world[i].clear();
+        }
+        dirty = true;
+    }
+
+    void setPosition(int node, const glm::vec3& position)
+    {
+        for (int axis = 0; axis < 3; axis++)
+            positions[axis][node] = position[axis];
+        dirty = true;
+    }
+    // sine and cosine are taken here, once, so the kernel is plain multiply-adds
+    void setRotation(int node, const glm::vec3& degrees)
+    {
+        for (int axis = 0; axis < 3; axis++)
+        {
+            float angle = glm::radians(degrees[axis]);
+            cosines[axis][node] = std::cos(angle);
+            sines[axis][node] = std::sin(angle);
+        }
+        dirty = true;
+    }
+    void setScale(int node, const glm::vec3& scale)
+    {
+        for (int axis = 0; axis < 3; axis++)
+            scales[axis][node] = scale[axis];
+        dirty = true;
+    }
+
+    // composes local and world matrices of every node; does nothing when no transform changed
+    void update()
+    {
+        if (!dirty)
+            return;
+        int count = (int)parents.size();
+        const int width = TransformLanes::WIDTH;
+        int node = 0;
+        for (; node + width <= count; node += width)
+            composeLocalLanes(node);
+        for (; node < count; node++)
+            composeLocal(node);
+
+        node = 0;
+        for (; node + width <= count; node += width)
+        {
+            // a parent inside the same group is not composed yet; do that group one node at a time
+            bool independent = true;
+            for (int lane = 0; lane < width; lane++)
+                independent = independent && parents[node + lane] < node;
+            if (independent)
+                composeWorldLanes(node);
+            else
+                for (int lane = 0; lane < width; lane++)
+                    composeWorld(node + lane);
+        }
+        for (; node < count; node++)
+            composeWorld(node);
+        dirty = false;
+    }
+
+    glm::mat4 getWorld(int node) const
+    {
+        glm::mat4 matrix(1.0f);
+        for (int column = 0; column < 4; column++)
+            for (int row = 0; row < 3; row++)
+                matrix[column][row] = world[column * 3 + row][node];
+        return matrix;
+    }
+    // the same matrix as it is stored, ready for instance data and mat3x4 uniforms
+    Affine getAffine(int node) const
+    {
+        Affine affine;
+        for (int row = 0; row < 3; row++)
+            for (int column = 0; column < 4; column++)
+                affine.rows[row][column] = world[column * 3 + row][node];
+        return affine;
+    }
+    size_t size() const
+    {
+        return parents.size();
+    }
+
+private:
+    // rotation Rx * Ry * Rz times scale, written out per entry, plus the translation column
+    void composeLocalLanes(int node)
+    {
+        typedef TransformLanes L;
+        L::Type cx = L::load(&cosines[0][node]), sx = L::load(&sines[0][node]);
+        L::Type cy = L::load(&cosines[1][node]), sy = L::load(&sines[1][node]);
+        L::Type cz = L::load(&cosines[2][node]), sz = L::load(&sines[2][node]);
+        L::Type scaleX = L::load(&scales[0][node]);
+        L::Type scaleY = L::load(&scales[1][node]);
+        L::Type scaleZ = L::load(&scales[2][node]);
+        L::Type sxsy = L::mul(sx, sy);
+        L::Type cxsy = L::mul(cx, sy);
+        L::Type zero = L::zero();
+
+        L::store(&local[0][node], L::mul(L::mul(cy, cz), scaleX));
+        L::store(&local[1][node], L::mul(L::add(L::mul(sxsy, cz), L::mul(cx, sz)), scaleX));
+        L::store(&local[2][node], L::mul(L::sub(L::mul(sx, sz), L::mul(cxsy, cz)), scaleX));
+
+        L::store(&local[3][node], L::mul(L::sub(zero, L::mul(cy, sz)), scaleY));
+        L::store(&local[4][node], L::mul(L::sub(L::mul(cx, cz), L::mul(sxsy, sz)), scaleY));
+        L::store(&local[5][node], L::mul(L::add(L::mul(cxsy, sz), L::mul(sx, cz)), scaleY));
+
+        L::store(&local[6][node], L::mul(sy, scaleZ));
+        L::store(&local[7][node], L::mul(L::sub(zero, L::mul(sx, cy)), scaleZ));
+        L::store(&local[8][node], L::mul(L::mul(cx, cy), scaleZ));
+
+        L::store(&local[9][node], L::load(&positions[0][node]));
+        L::store(&local[10][node], L::load(&positions[1][node]));
+        L::store(&local[11][node], L::load(&positions[2][node]));
+    }
+
+    void composeLocal(int node)
+    {
+        float cx = cosines[0][node], sx = sines[0][node];
+        float cy = cosines[1][node], sy = sines[1][node];
+        float cz = cosines[2][node], sz = sines[2][node];
+        float scaleX = scales[0][node], scaleY = scales[1][node], scaleZ = scales[2][node];
+
+        local[0][node] = cy * cz * scaleX;
+        local[1][node] = (sx * sy * cz + cx * sz) * scaleX;
+        local[2][node] = (sx * sz - cx * sy * cz) * scaleX;
+        local[3][node] = -cy * sz * scaleY;
+        local[4][node] = (cx * cz - sx * sy * sz) * scaleY;
+        local[5][node] = (cx * sy * sz + sx * cz) * scaleY;
+        local[6][node] = sy * scaleZ;
+        local[7][node] = -sx * cy * scaleZ;
+        local[8][node] = cx * cy * scaleZ;
+        local[9][node] = positions[0][node];
+        local[10][node] = positions[1][node];
+        local[11][node] = positions[2][node];
+    }
+
+    // world = parentWorld * local for WIDTH nodes whose parents are all finished; roots use identity
+    void composeWorldLanes(int node)
+    {
+        typedef TransformLanes L;
+        const int width = L::WIDTH;
+        static const float IDENTITY[MATRIX_FLOATS] = { 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f };
+        L::Type parent[MATRIX_FLOATS];
+        for (int i = 0; i < MATRIX_FLOATS; i++)
+        {
+            float gathered[width];
+            for (int lane = 0; lane < width; lane++)
+            {
+                int p = parents[node + lane];
+                gathered[lane] = p >= 0 ? world[i][p] : IDENTITY[i];
+            }
+            parent[i] = L::load(gathered);
+        }
+
+        for (int column = 0; column < 4; column++)
+        {
+            L::Type x = L::load(&local[column * 3 + 0][node]);
+            L::Type y = L::load(&local[column * 3 + 1][node]);
+            L::Type z = L::load(&local[column * 3 + 2][node]);
+            for (int row = 0; row < 3; row++)
+            {
+                L::Type value = L::add(L::add(L::mul(parent[row], x), L::mul(parent[3 + row], y)), L::mul(parent[6 + row], z));
+                if (column == 3)
+                    value = L::add(value, parent[9 + row]);
+                L::store(&world[column * 3 + row][node], value);
+            }
+        }
+    }
+
+    void composeWorld(int node)
+    {
+        int p = parents[node];
+        for (int column = 0; column < 4; column++)
+        {
+            float x = local[column * 3 + 0][node];
+            float y = local[column * 3 + 1][node];
+            float z = local[column * 3 + 2][node];
+            for (int row = 0; row < 3; row++)
+            {
+                float value;
+                if (p < 0)
+                    value = local[column * 3 + row][node];
+                else
+                {
+                    value = world[row][p] * x + world[3 + row][p] * y + world[6 + row][p] * z;
+                    if (column == 3)
+                        value += world[9 + row][p];
+                }
+                world[column * 3 + row][node] = value;
+            }
+        }
+    }
+
+    std::vector<int> parents;
+    std::vector<float> positions[3];
+    std::vector<float> cosines[3];          // of the Euler angles, per axis
+    std::vector<float> sines[3];
+    std::vector<float> scales[3];
+    std::vector<float> local[MATRIX_FLOATS];
+    std::vector<float> world[MATRIX_FLOATS];
+    bool dirty = false;
+};
+
+#endif /* TRANSFORM_STORE_H */
@@ -0,0 +1,63 @@
+//
+//  uniformBlocks.h
+//  fixed binding points of the std140 uniform blocks shared by every program
+//
+
+#ifndef UNIFORM_BLOCKS_H
+#define UNIFORM_BLOCKS_H
+
+#include <cstddef>
+#include <glad/glad.h>
+
+// a block declared in any shader under one of these names is bound to the same point in every program,
+// so each buffer is bound once and written once per change no matter how many programs read it
+const GLuint FRAME_BINDING = 0;                 // Frame: projection, view, viewPos (see frameUniforms.h)
+const GLuint POINT_LIGHT_BINDING = 1;           // PointLights (see lightManager.h)
+const GLuint SPOT_LIGHT_BINDING = 2;            // SpotLights
+const GLuint DIRECTIONAL_LIGHT_BINDING = 3;     // DirectionalLightBlock
+const GLuint MATERIAL_BINDING = 4;              // Materials (see materialTable.h)
+
+// points the program's shared blocks at their binding points; Shader calls it once after linking
+inline void bindUniformBlocks(GLuint program)
+{
+    struct Block
+    {
+        const char* name;
+        GLuint binding;
+    };
+    const Block blocks[] = {
+        { "Frame", FRAME_BINDING },
+        { "PointLights", POINT_LIGHT_BINDING },
+        { "SpotLights", SPOT_LIGHT_BINDING },
+        { "DirectionalLightBlock", DIRECTIONAL_LIGHT_BINDING },
+        { "Materials", MATERIAL_BINDING },
+    };
+    for (const Block& block : blocks)
+    {
+        GLuint index = glGetUniformBlockIndex(program, block.name);
+        if (index != GL_INVALID_INDEX)
+            glUniformBlockBinding(program, index, block.binding);
+    }
+}
+
+// a GL_DYNAMIC_DRAW uniform buffer of size bytes, left bound to binding for the rest of the run
+inline GLuint createUniformBuffer(GLuint binding, size_t size)
+{
+    GLuint buffer = 0;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+    glBufferData(GL_UNIFORM_BUFFER, size, nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, binding, buffer);
+    return buffer;
+}
+
+// writes bytes at offset into buffer
+inline void updateUniformBuffer(GLuint buffer, size_t offset, size_t size, const void* data)
+{
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, offset, size, data);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+#endif /* UNIFORM_BLOCKS_H */
@@ -0,0 +1,75 @@
+//
+//  vertexPacking.h
+//  12 byte vertex layout for the VERTEX_PACKED mesh arena
+//
+
+#ifndef VERTEX_PACKING_H
+#define VERTEX_PACKING_H
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+// position = (x, y, z) / 65535 * positionScale + positionBias in the vertex shader
+struct PackedVertex
+{
+    uint16_t position[3];       // unorm16 relative to the mesh bounds
+    uint16_t padding;           // keeps the normal 4 byte aligned
+    uint32_t normal;            // GL_INT_2_10_10_10_REV, snorm
+};
+
+// 10 bit signed normalized x, y, z; w is left 0
+inline uint32_t packNormal(float x, float y, float z)
+{
+    float length = sqrtf(x * x + y * y + z * z);
+    float lengthInv = length > 0.000001f ? 1.0f / length : 0.0f;
+    float n[3] = { x * lengthInv, y * lengthInv, z * lengthInv };
+    uint32_t packed = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        int value = (int)roundf(glm::clamp(n[i], -1.0f, 1.0f) * 511.0f);
+        packed |= ((uint32_t)value & 0x3FF) << (10 * i);
+    }
+    return packed;
+}
+
+// quantize interleaved float position + normal vertices; returns the dequantization scale and bias
+inline void packVertices(const std::vector<float>& vertices, std::vector<PackedVertex>& packed,
+    glm::vec3& positionScale, glm::vec3& positionBias)
+{
+    size_t count = vertices.size() / 6;
+    packed.resize(count);
+    if (count == 0)
+    {
+        positionScale = glm::vec3(1.0f);
+        positionBias = glm::vec3(0.0f);
+        return;
+    }
+
+    glm::vec3 minimum(vertices[0], vertices[1], vertices[2]);
+    glm::vec3 maximum = minimum;
+    for (size_t i = 0; i < count; i++)
+    {
+        glm::vec3 p(vertices[i * 6], vertices[i * 6 + 1], vertices[i * 6 + 2]);
+        minimum = glm::min(minimum, p);
+        maximum = glm::max(maximum, p);
+    }
+    positionBias = minimum;
+    positionScale = maximum - minimum;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        const float* v = &vertices[i * 6];
+        for (int axis = 0; axis < 3; axis++)
+        {
+            float extent = positionScale[axis];
+            float t = extent > 0.0f ? (v[axis] - minimum[axis]) / extent : 0.0f;
+            packed[i].position[axis] = (uint16_t)roundf(glm::clamp(t, 0.0f, 1.0f) * 65535.0f);
+        }
+        packed[i].padding = 0;
+        packed[i].normal = packNormal(v[3], v[4], v[5]);
+    }
+}
+
+#endif /* VERTEX_PACKING_H */
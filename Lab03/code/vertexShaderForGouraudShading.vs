@@ -4,54 +4,73 @@ layout (location = 1) in vec3 aNormal;
 
 out vec4 LightingColor;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+uniform mat3x4 model;     // rows of the affine model matrix (see affine.h)
+uniform mat3 normalMatrix;  // inverse transpose of its linear part, from Affine::normalMatrix()
+// packed meshes store positions as unorm16 relative to their bounds
+uniform vec3 positionScale = vec3(1.0);
+uniform vec3 positionBias = vec3(0.0);
 
 struct Material {
     vec3 ambient;
+    float shininess;
     vec3 diffuse;
     vec3 specular;
-    float shininess;
 };
 
+#define MAX_MATERIALS 256
+
+// every material of the scene; a draw only sets its index
+layout (std140) uniform Materials {
+    Material materials[MAX_MATERIALS];
+};
+
+// std140 layout filled by LightManager (see lightManager.h)
 struct PointLight {
     vec3 position;
-    
     float k_c;  // attenuation factors
-    float k_l;  // attenuation factors
-    float k_q;  // attenuation factors
-    
     vec3 ambient;
+    float k_l;  // attenuation factors
     vec3 diffuse;
+    float k_q;  // attenuation factors
     vec3 specular;
 };
 
+#define MAX_POINT_LIGHTS 255
 
-#define NR_POINT_LIGHTS 4
+layout (std140) uniform PointLights {
+    int pointLightCount;
+    PointLight pointLights[MAX_POINT_LIGHTS];
+};
 
-uniform vec3 viewPos;
-uniform PointLight pointLights[NR_POINT_LIGHTS];
-uniform Material material;
+// camera of the frame, shared by every program
+layout (std140) uniform Frame {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+};
+uniform int materialIndex;
 
 // function prototypes
 vec3 CalcPointLight(Material material, PointLight light, vec3 N, vec3 Pos, vec3 V);
 
 void main()
 {
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    vec3 position = aPos * positionScale + positionBias;
+    vec3 worldPosition = vec4(position, 1.0) * model;
+    gl_Position = projection * view * vec4(worldPosition, 1.0);
     
-    vec3 Pos = vec3(model * vec4(aPos, 1.0));
-    vec3 Normal = mat3(transpose(inverse(model))) * aNormal;
+    vec3 Pos = worldPosition;
+    vec3 Normal = normalMatrix * aNormal;
     
     // properties
     vec3 N = normalize(Normal);
     vec3 V = normalize(viewPos - Pos);
+    Material material = materials[materialIndex];
 
-    vec3 result;
+    vec3 result = vec3(0.0);
     
     // point lights
-    for(int i = 0; i < NR_POINT_LIGHTS; i++)
+    for(int i = 0; i < pointLightCount; i++)
         result += CalcPointLight(material, pointLights[i], N, Pos, V);
     
     LightingColor = vec4(result, 1.0);
@@ -2,18 +2,56 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 
+// std140 order: shininess shares the slot after ambient
+struct Material {
+    vec3 ambient;
+    float shininess;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+#define MAX_MATERIALS 256
+
+// every material of the scene (see materialTable.h); a draw only sets its index
+layout (std140) uniform Materials {
+    Material materials[MAX_MATERIALS];
+};
+
+// camera of the frame, shared by every program (see frameUniforms.h)
+layout (std140) uniform Frame {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+};
+
+// the depth pre-pass and the GL_EQUAL shading pass are separate programs that must agree on depth
+invariant gl_Position;
+
 out vec3 FragPos;
 out vec3 Normal;
+flat out vec3 MaterialAmbient;
+flat out vec3 MaterialDiffuse;
+flat out vec3 MaterialSpecular;
+flat out float MaterialShininess;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+uniform mat3x4 model;     // rows of the affine model matrix (see affine.h)
+uniform mat3 normalMatrix;  // inverse transpose of its linear part, from Affine::normalMatrix()
+// packed meshes store positions as unorm16 relative to their bounds
+uniform vec3 positionScale = vec3(1.0);
+uniform vec3 positionBias = vec3(0.0);
+uniform int materialIndex;
 
 void main()
 {
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    vec3 position = aPos * positionScale + positionBias;
+    FragPos = vec4(position, 1.0) * model;
+    gl_Position = projection * view * vec4(FragPos, 1.0);
     
-    FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(model))) * aNormal;
+    Normal = normalMatrix * aNormal;
+    Material material = materials[materialIndex];
+    MaterialAmbient = material.ambient;
+    MaterialDiffuse = material.diffuse;
+    MaterialSpecular = material.specular;
+    MaterialShininess = material.shininess;
     
 }
@@ -0,0 +1,41 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+
+// per-instance attributes (see boxBatch.h)
+layout (location = 2) in mat3x4 aModel;   // rows of the affine model matrix, locations 2-4
+layout (location = 6) in vec3 aAmbient;
+layout (location = 7) in vec3 aDiffuse;
+layout (location = 8) in vec3 aSpecular;
+layout (location = 9) in float aShininess;
+layout (location = 10) in mat3 aNormalMatrix;   // locations 10-12
+
+// the depth pre-pass and the GL_EQUAL shading pass are separate programs that must agree on depth
+invariant gl_Position;
+
+out vec3 FragPos;
+out vec3 Normal;
+flat out vec3 MaterialAmbient;
+flat out vec3 MaterialDiffuse;
+flat out vec3 MaterialSpecular;
+flat out float MaterialShininess;
+
+// camera of the frame, shared by every program (see frameUniforms.h)
+layout (std140) uniform Frame {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+};
+
+void main()
+{
+    FragPos = vec4(aPos, 1.0) * aModel;
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+    
+    Normal = aNormalMatrix * aNormal;
+    MaterialAmbient = aAmbient;
+    MaterialDiffuse = aDiffuse;
+    MaterialSpecular = aSpecular;
+    MaterialShininess = aShininess;
+    
+}